@@ -2,8 +2,13 @@
 /* This file should hold your implementation of the predictor simulator */
 /* C file */
 /* update 05/05/2025 - */
+#ifdef BP_PROFILE
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
 #include "bp_api.h"
+#include "bp_prof.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 // share define
@@ -14,6 +19,9 @@
 
 //HELP FUNCTION DECLERATION:
 uint32_t bit_slice (uint32_t field , unsigned len , unsigned shift);
+static uint32_t gshare_index (uint32_t pc);
+static void push_global_history (bool taken);
+static uint32_t chooser_index (uint32_t pc);
 
 
 // FSM states -using enum
@@ -47,15 +55,78 @@ static uint32_t bt_globalHistory;
 static int *bt_globalFsm=NULL;
 static BtbEntry *bt_btbTable= NULL;
 
+// tournament : local history component (configured tables) + gshare component + chooser
+static int bt_tournament = BP_TOURNAMENT_OFF;
+static int *bt_gshareFsm=NULL;
+static int *bt_chooser=NULL; // 2 bit counters, >= WT picks gshare
+
+// long global history : the last bt_longHistory outcomes in a circular bit buffer, folded into
+// bt_historySize bits in bt_globalHistory - one xor fold step per branch, whatever the length
+static unsigned bt_longHistory = 0; // 0 - plain bt_historySize bit shift register
+static uint32_t bt_longBits[BP_MAX_LONG_HISTORY / 32];
+static unsigned bt_longHead = 0; // oldest outcome, the next one is written over it
+
 // statistics tracking
 
 static unsigned numberOfPredictions =0; // number of predictions
 static unsigned numberOfFlushes =0 ; // number of flushes
+static unsigned localChosen =0, localCorrect =0; // tournament - component selection
+static unsigned gshareChosen =0, gshareCorrect =0;
+
+#ifdef BP_PROFILE
+#include <stdio.h>
+#include <time.h>
+
+uint64_t bp_prof_ticks[BP_PROF_PHASES];
+uint64_t bp_prof_start[BP_PROF_PHASES];
+double bp_prof_calls[BP_PROF_PHASES];
+static uint64_t bp_prof_runTicks; // run start, ticks and wall clock - scales ticks to ns
+static double bp_prof_runNs;
+
+static double bp_prof_wallNs(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#if !(defined(__x86_64__) || defined(__i386__))
+uint64_t bp_prof_now(void){
+	return (uint64_t)bp_prof_wallNs();
+}
+#endif
+
+// per phase breakdown at exit, one record is one branch
+static void bp_prof_report(void){
+	static const char *names[BP_PROF_PHASES] = {"decode", "predict", "update", "output"};
+	double ns = bp_prof_wallNs() - bp_prof_runNs;
+	uint64_t ticks = bp_prof_now() - bp_prof_runTicks;
+	double nsPerTick = ticks ? ns / ticks : 0;
+	double records = bp_prof_calls[BP_PROF_UPDATE];
+	fprintf(stderr, "profile records=%.0f wallNs=%.0f ns/record=%.03f\n", records, ns,
+			records ? ns / records : 0);
+	for (int p = 0; p < BP_PROF_PHASES; p++) {
+		double phaseNs = bp_prof_ticks[p] * nsPerTick;
+		fprintf(stderr, "profile phase=%s calls=%.0f ns=%.0f ns/record=%.03f ns/call=%.03f\n", names[p],
+				bp_prof_calls[p], phaseNs, records ? phaseNs / records : 0,
+				bp_prof_calls[p] ? phaseNs / bp_prof_calls[p] : 0);
+	}
+}
+#endif
 
 
 
 
 
+/* tournament mode - set before BP_init */
+void BP_setTournament(int chooser){
+	bt_tournament = chooser;
+}
+
+/* long global history - set before BP_init */
+void BP_setLongHistory(unsigned length){
+	bt_longHistory = length;
+}
+
 /* initialization function :*/
 int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned fsmState,
 			bool isGlobalHist, bool isGlobalTable, int Shared){
@@ -68,7 +139,25 @@ int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned f
 	bt_isGlobalHist = isGlobalHist;
 	bt_isGlobalTable = isGlobalTable;
 	bt_shared = Shared;
+#ifdef BP_PROFILE
+	bp_prof_runTicks = bp_prof_now();
+	bp_prof_runNs = bp_prof_wallNs();
+	atexit(bp_prof_report);
+#endif
 	bt_globalHistory=0;
+	if(bt_longHistory > BP_MAX_LONG_HISTORY){
+		return -1;
+	}
+	// the configured scheme is the local component of a tournament, gshare is the global one
+	if(isGlobalHist && bt_tournament != BP_TOURNAMENT_OFF){
+		return -1;
+	}
+	// the long history is folded into the global history register - it needs one to fold into
+	if(bt_longHistory && (bt_historySize == 0 || (!isGlobalHist && bt_tournament == BP_TOURNAMENT_OFF))){
+		return -1;
+	}
+	memset(bt_longBits, 0, sizeof(bt_longBits));
+	bt_longHead = 0;
 
 	
 	// allocate global fsm if needed :
@@ -83,12 +172,34 @@ int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned f
 	}
 	
 
+	// allocate gshare table and chooser if needed :
+	if(bt_tournament != BP_TOURNAMENT_OFF){
+		bt_gshareFsm = (int*)malloc(sizeof(int)*(1 << bt_historySize));
+		bt_chooser = (int*)malloc(sizeof(int)*(1 << bt_historySize));
+		if(!bt_gshareFsm || !bt_chooser){
+			free(bt_gshareFsm);
+			free(bt_chooser);
+			if(bt_isGlobalTable){
+				free(bt_globalFsm);
+			}
+			return -1;
+		}
+		for(unsigned i =0; i<(1 << bt_historySize); i++){
+			bt_gshareFsm[i]=bt_fsmState;
+			bt_chooser[i]=WNT; // start weakly on the local component
+		}
+	}
+
 	//allocate btb table
 	bt_btbTable = (BtbEntry*)malloc(sizeof(BtbEntry)*btbSize);
 	if(!bt_btbTable){
 		if(bt_isGlobalTable){
 			free(bt_globalFsm);
 		}
+		if(bt_tournament != BP_TOURNAMENT_OFF){
+			free(bt_gshareFsm);
+			free(bt_chooser);
+		}
 		return -1;
 	}
 
@@ -106,6 +217,10 @@ int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned f
 					free(bt_btbTable[k].localFsm);
 				}
 				free(bt_btbTable);
+				if(bt_tournament != BP_TOURNAMENT_OFF){
+					free(bt_gshareFsm);
+					free(bt_chooser);
+				}
 				return -1;
 			}
 
@@ -127,6 +242,7 @@ int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned f
 /* prediction function */
 bool BP_predict(uint32_t pc, uint32_t *dst){
 
+	BP_PROF_BEGIN(BP_PROF_PREDICT);
 	// calc index and tag
 	unsigned btbIndexBits = __builtin_ctz(bt_btbSize);
 	uint32_t index = bit_slice(pc, btbIndexBits, 2);
@@ -137,6 +253,7 @@ bool BP_predict(uint32_t pc, uint32_t *dst){
 	//check 
 	if (!bt_btbTable[index].validBit || bt_btbTable[index].tag != tag) {
 		*dst = pc + 4;
+		BP_PROF_END(BP_PROF_PREDICT);
 		return false;
 	}
 	
@@ -161,7 +278,11 @@ bool BP_predict(uint32_t pc, uint32_t *dst){
 	 int currentState = bt_isGlobalTable ? bt_globalFsm[fsmIndex] : bt_btbTable[index].localFsm[fsmIndex];
 
 	 bool taken = (currentState >= WT);
+	 if(bt_tournament != BP_TOURNAMENT_OFF && bt_chooser[chooser_index(pc)] >= WT){
+		 taken = (bt_gshareFsm[gshare_index(pc)] >= WT);
+	 }
 	 *dst= taken ? bt_btbTable[index].target : pc+4;
+	 BP_PROF_END(BP_PROF_PREDICT);
 	 return taken; 
 }
 
@@ -170,6 +291,7 @@ bool BP_predict(uint32_t pc, uint32_t *dst){
 /* bp update function */
 void BP_update(uint32_t pc, uint32_t targetPc, bool taken, uint32_t pred_dst){
 	
+	BP_PROF_BEGIN(BP_PROF_UPDATE);
 	// update statistics :
 	if((taken && targetPc != pred_dst) || (!taken && ((pc+4) != pred_dst))) {
 		numberOfFlushes++;
@@ -178,6 +300,7 @@ void BP_update(uint32_t pc, uint32_t targetPc, bool taken, uint32_t pred_dst){
 	unsigned btbIndexBits = __builtin_ctz(bt_btbSize);
 	uint32_t index = bit_slice(pc, btbIndexBits, 2);
 	uint32_t tag = bit_slice(pc, bt_tagSize , 2 + btbIndexBits );
+	bool btbHit = bt_btbTable[index].validBit && bt_btbTable[index].tag == tag; // BP_predict used the fsm
 
 	//update entry if neeeded
 	if(!bt_btbTable[index].validBit || bt_btbTable[index].tag != tag){
@@ -210,6 +333,40 @@ void BP_update(uint32_t pc, uint32_t targetPc, bool taken, uint32_t pred_dst){
 	// fsm index calc
 	uint32_t fsmIndex = historySource & ((1 << bt_historySize) -1);
 
+	// tournament : count and train the chooser on the prediction BP_predict made, then train gshare
+	if(bt_tournament != BP_TOURNAMENT_OFF){
+		int localState = bt_isGlobalTable ? bt_globalFsm[fsmIndex] : bt_btbTable[index].localFsm[fsmIndex];
+		bool localTaken = (localState >= WT);
+		uint32_t gshareIndex = gshare_index(pc);
+		bool gshareTaken = (bt_gshareFsm[gshareIndex] >= WT);
+		int *chooser = &bt_chooser[chooser_index(pc)];
+		if(btbHit){
+			if(*chooser >= WT){
+				gshareChosen++;
+				gshareCorrect += (gshareTaken == taken);
+			}
+			else{
+				localChosen++;
+				localCorrect += (localTaken == taken);
+			}
+			// move towards the component that was right when they disagree
+			if(localTaken != gshareTaken){
+				if(gshareTaken == taken && *chooser < ST){
+					(*chooser)++;
+				}
+				else if(localTaken == taken && *chooser > SNT){
+					(*chooser)--;
+				}
+			}
+		}
+		if(taken && bt_gshareFsm[gshareIndex] < ST){
+			bt_gshareFsm[gshareIndex]++;
+		}
+		else if(!taken && bt_gshareFsm[gshareIndex] > SNT){
+			bt_gshareFsm[gshareIndex]--;
+		}
+	}
+
 	// update fsm (global or local ) and update history (global or local)
 	if(bt_isGlobalTable){
 		if(taken && bt_globalFsm[fsmIndex] < ST){
@@ -227,15 +384,16 @@ void BP_update(uint32_t pc, uint32_t targetPc, bool taken, uint32_t pred_dst){
 		}
 	}
 
-	if(bt_isGlobalHist){
-		bt_globalHistory = ((bt_globalHistory << 1) | taken ) & ((1 << bt_historySize) -1);
+	if(bt_isGlobalHist || bt_tournament != BP_TOURNAMENT_OFF){
+		push_global_history(taken);
 	}
-	else{
+	if(!bt_isGlobalHist){
 		bt_btbTable[index].localHistory = ((bt_btbTable[index].localHistory << 1) | taken ) & ((1 << bt_historySize) -1);
 	}
 	//update target
 	bt_btbTable[index].target = targetPc;
 
+	BP_PROF_END(BP_PROF_UPDATE);
 	return;
 }
  // clean up and return statistics
@@ -243,11 +401,16 @@ void BP_GetStats(SIM_stats *curStats){
 
 	curStats->flush_num =numberOfFlushes;
 	curStats->br_num = numberOfPredictions;
+	curStats->local_chosen = localChosen;
+	curStats->local_correct = localCorrect;
+	curStats->gshare_chosen = gshareChosen;
+	curStats->gshare_correct = gshareCorrect;
 
 	//memory usage calc - in theory
 	unsigned memorySize = 0;
+	unsigned globalHistoryBits = bt_historySize + bt_longHistory; // long - buffer + folded register
 	if(bt_isGlobalHist){
-		memorySize +=bt_historySize;
+		memorySize +=globalHistoryBits;
 	}
 	else{
 		memorySize += bt_historySize *bt_btbSize;
@@ -260,6 +423,10 @@ void BP_GetStats(SIM_stats *curStats){
 		memorySize += bt_btbSize * 2 * (1 << bt_historySize);
 	}
 	memorySize += bt_btbSize * (bt_tagSize+30+ 1);
+	// tournament : global history, gshare table and chooser on top of the local component
+	if(bt_tournament != BP_TOURNAMENT_OFF){
+		memorySize += globalHistoryBits + 2* (1 << bt_historySize) + 2* (1 << bt_historySize);
+	}
 	curStats->size = memorySize;
 
 
@@ -275,9 +442,18 @@ void BP_GetStats(SIM_stats *curStats){
 
 	}
 	free(bt_btbTable);
+	if(bt_tournament != BP_TOURNAMENT_OFF){
+		free(bt_gshareFsm);
+		free(bt_chooser);
+	}
 	return;
 }
 
+unsigned BP_getFlushes(void){
+
+	return numberOfFlushes;
+}
+
 /* bit_slicing help function */
 uint32_t bit_slice (uint32_t field , unsigned len , unsigned shift){
 
@@ -285,3 +461,39 @@ uint32_t bit_slice (uint32_t field , unsigned len , unsigned shift){
 	return (field >> shift) & mask ;
 }
 
+/* gshare index - global history xor pc bits (mid bits with using_share_mid, else lsb) */
+static uint32_t gshare_index (uint32_t pc){
+
+	unsigned shift = (bt_shared == USING_SHARE_MID) ? 16 : 2;
+	return (bt_globalHistory ^ bit_slice(pc , bt_historySize , shift)) & ((1 << bt_historySize) -1);
+}
+
+/* chooser index - pc bits or the global history */
+static uint32_t chooser_index (uint32_t pc){
+
+	if(bt_tournament == BP_TOURNAMENT_GLOBAL){
+		return bt_globalHistory;
+	}
+	return bit_slice(pc , bt_historySize , 2);
+}
+
+/* shift an outcome into the global history - with a long history the outcome leaving the */
+/* buffer is xored out of the folded register at its fold position (length % width)       */
+static void push_global_history (bool taken){
+
+	uint32_t mask = (1 << bt_historySize) - 1;
+	if(!bt_longHistory){
+		bt_globalHistory = ((bt_globalHistory << 1) | taken ) & mask;
+		return;
+	}
+	uint32_t *word = &bt_longBits[bt_longHead >> 5];
+	uint32_t bit = 1u << (bt_longHead & 31);
+	uint32_t out = (*word & bit) != 0;
+	*word = taken ? (*word | bit) : (*word & ~bit);
+	bt_longHead = (bt_longHead + 1 == bt_longHistory) ? 0 : bt_longHead + 1;
+
+	uint32_t folded = (bt_globalHistory << 1) | taken;
+	folded ^= out << (bt_longHistory % bt_historySize);
+	folded ^= folded >> bt_historySize;
+	bt_globalHistory = folded & mask;
+}
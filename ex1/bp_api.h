@@ -16,8 +16,17 @@ typedef struct {
 	unsigned flush_num;           // Machine flushes
 	unsigned br_num;      	      // Number of branch instructions
 	unsigned size;		      // Theoretical allocated BTB and branch predictor size
+	unsigned local_chosen;        // Tournament - btb hits predicted by the local component
+	unsigned local_correct;       // Tournament - ... with the right direction
+	unsigned gshare_chosen;       // Tournament - btb hits predicted by the gshare component
+	unsigned gshare_correct;      // Tournament - ... with the right direction
 } SIM_stats;
 
+/* Tournament chooser - how the 2 bit chooser counters are indexed */
+#define BP_TOURNAMENT_OFF 0       // single scheme as configured
+#define BP_TOURNAMENT_PC 1        // by pc bits
+#define BP_TOURNAMENT_GLOBAL 2    // by the global history
+
 /*************************************************************************/
 /* The following functions should be implemented in your bp.c (or .cpp) */
 /*************************************************************************/
@@ -30,6 +39,25 @@ typedef struct {
 int BP_init(unsigned btbSize, unsigned historySize, unsigned tagSize, unsigned fsmState,
 bool isGlobalHist, bool isGlobalTable, int Shared);
 
+/*
+ * BP_setTournament - call before BP_init to run a local history component (with the
+ * configured tables and share) and a gshare component side by side, a 2 bit chooser
+ * per entry picks one of them (>= weakly taken picks gshare). BP_init fails if the
+ * configured scheme is global_history - the local component needs local histories
+ * param[in] chooser - BP_TOURNAMENT_OFF, BP_TOURNAMENT_PC or BP_TOURNAMENT_GLOBAL
+ */
+void BP_setTournament(int chooser);
+
+/*
+ * BP_setLongHistory - call before BP_init to keep the last length (<= BP_MAX_LONG_HISTORY)
+ * outcomes as the global history, folded to historySize bits for the table index, so the
+ * history is longer than the tables are wide. 0 keeps the historySize bit register.
+ * BP_init fails if there is no global history to fold into (local history without a
+ * tournament, or historySize 0)
+ */
+#define BP_MAX_LONG_HISTORY 4096
+void BP_setLongHistory(unsigned length);
+
 /*
  * BP_predict - returns the predictor's prediction (taken / not taken) and predicted target address
  * param[in] pc - the branch instruction address
@@ -53,6 +81,12 @@ void BP_update(uint32_t pc, uint32_t targetPc, bool taken, uint32_t pred_dst);
  */
 void BP_GetStats(SIM_stats *curStats);
 
+/*
+ * BP_getFlushes - machine flushes so far, unlike BP_GetStats it keeps the predictor
+ * so it can be read between updates (a flush is the increase over one BP_update)
+ */
+unsigned BP_getFlushes(void);
+
 
 #ifdef __cplusplus
 }
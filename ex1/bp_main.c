@@ -1,13 +1,88 @@
 /* 046267 Computer Architecture - HW #1 */
 /* Main program                     	*/
 /* Usage: ./bp_main <trace filename>  	*/
+/*        ("-" reads stdin, a fifo path works like a file) */
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "bp_api.h"
+#include "bp_prof.h"
+
+/* Background trace decoder - a reader thread parses the branch lines into   */
+/* batches and passes them through a single producer / single consumer ring, */
+/* so reading and parsing overlap the predictor. head and tail only grow,    */
+/* each is written by one side and read by the other with acquire/release.   */
+#define TRACE_BATCH 4096
+#define TRACE_SLOTS 8
+
+typedef struct {
+	uint32_t pc;
+	uint32_t targetPc;
+	bool taken;
+} branch_rec;
+
+typedef struct {
+	branch_rec recs[TRACE_BATCH];
+	int count;
+} branch_batch;
+
+static branch_batch ring[TRACE_SLOTS];
+static size_t ring_head = 0;	// next batch the predictor takes
+static size_t ring_tail = 0;	// next batch the decoder fills
+static int ring_done = 0;	// decoder finished, ring_error is final
+static int ring_error = 0;	// exit code of a bad trace line, 0 = none
+
+static void *decode_trace(void *arg) {
+	FILE *trace = (FILE *)arg;
+	char line[1024];
+	bool more = true;
+	size_t t;
+	for (t = 0; more; t++) {
+		while (t - __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) == TRACE_SLOTS) {
+			sched_yield();	// ring full
+		}
+		branch_batch *batch = &ring[t % TRACE_SLOTS];
+		batch->count = 0;
+		BP_PROF_BEGIN(BP_PROF_DECODE);
+		while (batch->count < TRACE_BATCH) {
+			if (fgets(line, 256, trace) == NULL || line[0] == '\n') {
+				more = false;
+				break;
+			}
+			char *elemnts[3];
+			int i = 0;
+			elemnts[0] = strtok(line, " ");
+			for (i = 1; i < 3; ++i) {
+				elemnts[i] = strtok(NULL, " \n");
+			}
+			branch_rec *rec = &batch->recs[batch->count];
+			rec->pc = (uint32_t) strtol(elemnts[0], NULL, 0);
+			rec->targetPc = (uint32_t) strtol(elemnts[2], NULL, 0);
+			if (strcmp(elemnts[1], "T") == 0) {
+				rec->taken = true;
+			} else if (strcmp(elemnts[1], "N") == 0) {
+				rec->taken = false;
+			} else {
+				ring_error = 9;
+				more = false;
+				break;
+			}
+			batch->count++;
+		}
+		BP_PROF_END(BP_PROF_DECODE);
+		if (batch->count > 0) {
+			__atomic_store_n(&ring_tail, t + 1, __ATOMIC_RELEASE);
+		}
+	}
+	__atomic_store_n(&ring_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
 
 int main(int argc, char **argv) {
 
@@ -16,7 +91,7 @@ int main(int argc, char **argv) {
 		exit(1);
 	}
 
-	FILE *trace = fopen(argv[1], "r");
+	FILE *trace = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "r");
 	if (trace == 0) {
 		fprintf(stderr, "cannot open trace file\n");
 		exit(2);
@@ -71,6 +146,22 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Error in input file: cannot read config\n");
 		exit(7);
 	}
+	/* optional: tournament_pc | tournament_global, long_history_<bits> */
+	int tournament = BP_TOURNAMENT_OFF;
+	unsigned longHistory = 0;
+	char *option;
+	while ((option = strtok(NULL, " \n")) != NULL) {
+		if (strcmp(option, "tournament_pc") == 0) {
+			tournament = BP_TOURNAMENT_PC;
+		} else if (strcmp(option, "tournament_global") == 0) {
+			tournament = BP_TOURNAMENT_GLOBAL;
+		} else if (sscanf(option, "long_history_%u", &longHistory) != 1 || longHistory == 0) {
+			fprintf(stderr, "Error in input file: cannot read config\n");
+			exit(11);
+		}
+	}
+	BP_setTournament(tournament);
+	BP_setLongHistory(longHistory);
 
 	if (BP_init(btbSize, historySize, tagSize,fsmState, isGlobalHist,
 			isGlobalTable, Shared) < 0) {
@@ -78,39 +169,53 @@ int main(int argc, char **argv) {
 		exit(8);
 	}
 
-	while ((fgets(line, 256, trace) != NULL)) {
-		if (line[0] == '\n') {
-			break;
-		}
-		char *elemnts[3];
-		int i = 0;
-		elemnts[0] = strtok(line, " ");
-		for (i = 1; i < 3; ++i) {
-			elemnts[i] = strtok(NULL, " \n");
+	pthread_t decoder;
+	if (pthread_create(&decoder, NULL, decode_trace, trace) != 0) {
+		fprintf(stderr, "cannot start trace decoder\n");
+		exit(10);
+	}
+	size_t h;
+	for (h = 0;; h++) {
+		while (__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == h) {
+			if (__atomic_load_n(&ring_done, __ATOMIC_ACQUIRE) &&
+					__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == h) {
+				break;
+			}
+			sched_yield();
 		}
-		uint32_t pc = (uint32_t) strtol(elemnts[0], NULL, 0);
-		uint32_t targetPc = (uint32_t) strtol(elemnts[2], NULL, 0);
-		bool taken;
-		if (strcmp(elemnts[1], "T") == 0) {
-			taken = true;
-		} else if (strcmp(elemnts[1], "N") == 0) {
-			taken = false;
-		} else {
-			fprintf(stderr, "Error in input file: bad trace\n");
-			exit(9);
+		if (__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == h) {
+			break;	// end of the trace
 		}
-		uint32_t dst = 0;
-		printf("0x%x ", pc);
-		printf("%c ", (BP_predict(pc, &dst)? 'T' : 'N'));
-		printf("0x%x\n", dst);
+		const branch_batch *batch = &ring[h % TRACE_SLOTS];
+		for (i = 0; i < batch->count; ++i) {
+			uint32_t pc = batch->recs[i].pc;
+			uint32_t targetPc = batch->recs[i].targetPc;
+			bool taken = batch->recs[i].taken;
+			uint32_t dst = 0;
+			bool predTaken = BP_predict(pc, &dst);
+			BP_PROF_BEGIN(BP_PROF_OUTPUT);
+			printf("0x%x ", pc);
+			printf("%c ", (predTaken ? 'T' : 'N'));
+			printf("0x%x\n", dst);
+			BP_PROF_END(BP_PROF_OUTPUT);
 
-
-		BP_update(pc, targetPc, taken, dst);
+			BP_update(pc, targetPc, taken, dst);
+		}
+		__atomic_store_n(&ring_head, h + 1, __ATOMIC_RELEASE);
+	}
+	pthread_join(decoder, NULL);
+	if (ring_error) {
+		fprintf(stderr, "Error in input file: bad trace\n");
+		exit(ring_error);
 	}
 
 	SIM_stats stats;
 	BP_GetStats(&stats);
 	printf("flush_num: %d, br_num: %d, size: %db\n", stats.flush_num, stats.br_num, stats.size);
+	if (tournament != BP_TOURNAMENT_OFF) {
+		printf("local_chosen: %d, local_correct: %d, gshare_chosen: %d, gshare_correct: %d\n",
+				stats.local_chosen, stats.local_correct, stats.gshare_chosen, stats.gshare_correct);
+	}
 
 	return 0;
 }
@@ -0,0 +1,39 @@
+/* 046267 Computer Architecture - HW #1 */
+/* Self profiling - build with -DBP_PROFILE (make PROFILE=1) to time the  */
+/* trace decoder, BP_predict, BP_update and the output, the breakdown is  */
+/* printed to stderr at exit. The default build compiles the marks out.   */
+
+#ifndef BP_PROF_H_
+#define BP_PROF_H_
+
+enum BpProfPhase {
+	BP_PROF_DECODE = 0,	// trace line parsing (decoder thread)
+	BP_PROF_PREDICT = 1,	// BP_predict - btb lookup and fsm read
+	BP_PROF_UPDATE = 2,	// BP_update - btb replacement, fsm and history update
+	BP_PROF_OUTPUT = 3,	// prediction lines
+	BP_PROF_PHASES = 4
+};
+
+#ifdef BP_PROFILE
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define bp_prof_now() ((uint64_t)__rdtsc())
+#else
+uint64_t bp_prof_now(void);
+#endif
+
+/* every phase is only marked by one thread, so the slots need no locking */
+extern uint64_t bp_prof_ticks[BP_PROF_PHASES];
+extern uint64_t bp_prof_start[BP_PROF_PHASES];
+extern double bp_prof_calls[BP_PROF_PHASES];
+
+#define BP_PROF_BEGIN(phase) (bp_prof_start[phase] = bp_prof_now())
+#define BP_PROF_END(phase) \
+	(bp_prof_ticks[phase] += bp_prof_now() - bp_prof_start[phase], bp_prof_calls[phase]++)
+#else
+#define BP_PROF_BEGIN(phase) ((void)0)
+#define BP_PROF_END(phase) ((void)0)
+#endif
+
+#endif /* BP_PROF_H_ */
@@ -0,0 +1,227 @@
+// course - Computer Architecture 046267
+// hw-2 cache simulator - throughput benchmark of CacheSystem::access on synthetic address streams
+// usage: cacheBench [--workload seq|stride|random|chase|zipf|all] [--accesses N] [--footprint log2]
+//                   [--stride bytes] [--sizes l1/l2,...] [--assocs a,...] [--seed N] [cache system flags]
+// prints one line per (workload, hierarchy, assoc) with accesses per second and the miss rates
+/*------------------------------------------------*/
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include "cacheSim.h"
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+// xorshift64* - fast and deterministic, the generators must not dominate the timing
+class BenchRandom {
+private:
+    unsigned long long state;
+public:
+    BenchRandom(unsigned long long seed) : state(seed ? seed : 1) {}
+    unsigned long long next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+    // uniform in [0, n)
+    unsigned long long below(unsigned long long n) {
+        return next() % n;
+    }
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// synthetic address stream over a footprint of 2^footprint bytes
+class Workload {
+private:
+    string kind;
+    unsigned long long footprint, blocks, stride, addr;
+    unsigned blockBits;
+    BenchRandom rng;
+    std::vector<unsigned long long> next; // chase - random single cycle over the blocks
+    double zipfTheta, zipfZeta, zipfAlpha, zipfEta; // zipf - ycsb style generator
+
+public:
+    Workload(const string& kind, unsigned footprintBits, unsigned blockBits, unsigned long long stride,
+             unsigned long long seed)
+        : kind(kind),
+          footprint(1ULL << footprintBits),
+          blocks(1ULL << (footprintBits - blockBits)),
+          stride(stride),
+          addr(0),
+          blockBits(blockBits),
+          rng(seed),
+          zipfTheta(0.99), zipfZeta(0), zipfAlpha(0), zipfEta(0) {
+        if (kind == "chase") {
+            // sattolo - one cycle through every block so the chase never short circuits
+            next.resize(blocks);
+            for (unsigned long long i = 0; i < blocks; i++) {
+                next[i] = i;
+            }
+            for (unsigned long long i = blocks - 1; i > 0; i--) {
+                std::swap(next[i], next[rng.below(i)]);
+            }
+        } else if (kind == "zipf") {
+            for (unsigned long long i = 1; i <= blocks; i++) {
+                zipfZeta += 1.0 / std::pow((double)i, zipfTheta);
+            }
+            double zeta2 = 1.0 + 1.0 / std::pow(2.0, zipfTheta);
+            zipfAlpha = 1.0 / (1.0 - zipfTheta);
+            zipfEta = (1.0 - std::pow(2.0 / blocks, 1.0 - zipfTheta)) / (1.0 - zeta2 / zipfZeta);
+        }
+    }
+    bool valid() const {
+        return kind == "seq" || kind == "stride" || kind == "random" || kind == "chase" || kind == "zipf";
+    }
+    // fill records with the next count accesses, one write in four
+    void generate(TraceRecord* records, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (kind == "seq") {
+                addr = (addr + 4) & (footprint - 1);
+            } else if (kind == "stride") {
+                addr += stride;
+                if (addr >= footprint) {
+                    addr = (addr + 4) & (footprint - 1); // shift the next pass by a word
+                }
+            } else if (kind == "random") {
+                addr = rng.below(footprint) & ~3ULL;
+            } else if (kind == "chase") {
+                addr = next[addr >> blockBits] << blockBits;
+            } else {
+                double u = rng.uniform();
+                double uz = u * zipfZeta;
+                unsigned long long rank;
+                if (uz < 1.0) {
+                    rank = 0;
+                } else if (uz < 1.0 + std::pow(0.5, zipfTheta)) {
+                    rank = 1;
+                } else {
+                    rank = (unsigned long long)(blocks * std::pow(zipfEta * u - zipfEta + 1, zipfAlpha));
+                }
+                // scatter the hot ranks so they do not share sets
+                rank = (rank * 2654435761ULL) & (blocks - 1);
+                addr = rank << blockBits;
+            }
+            records[i].address = addr;
+            records[i].operation = (i & 3) == 3 ? 'w' : 'r';
+        }
+    }
+};
+
+// comma separated list of unsigned values
+static std::vector<string> splitList(const string& list) {
+    std::vector<string> out;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+int main(int argc, char **argv) {
+	string WorkloadName = "all";
+	unsigned long long Accesses = 100000000ULL;
+	unsigned Footprint = 28; // 256MB
+	unsigned long long Stride = 256;
+	unsigned long long Seed = 1;
+	string Sizes = "15/18,15/20,16/22"; // l1/l2 sizes in log2 bytes
+	string Assocs = "0,2,3,4"; // log2 ways, both levels
+	SimConfig cfg;
+	cfg.MemCyc = 100;
+	cfg.BSize = 6;
+	cfg.WrAlloc = 1;
+	cfg.levels[0].Cyc = 1;
+	cfg.levels[1].Cyc = 10;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string s(argv[i]);
+		if (s == "--workload") {
+			WorkloadName = argv[i + 1];
+		} else if (s == "--accesses") {
+			Accesses = strtoull(argv[i + 1], NULL, 10);
+		} else if (s == "--footprint") {
+			Footprint = atoi(argv[i + 1]);
+		} else if (s == "--stride") {
+			Stride = strtoull(argv[i + 1], NULL, 10);
+		} else if (s == "--seed") {
+			Seed = strtoull(argv[i + 1], NULL, 10);
+		} else if (s == "--sizes") {
+			Sizes = argv[i + 1];
+		} else if (s == "--assocs") {
+			Assocs = argv[i + 1];
+		} else if (!parseSimOption(s, argv[i + 1], cfg)) {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+	}
+	if (Footprint <= cfg.BSize || Footprint >= 40 || Accesses == 0) {
+		cerr << "Error in arguments" << endl;
+		return 0;
+	}
+	std::vector<string> workloads;
+	if (WorkloadName == "all") {
+		workloads = splitList("seq,stride,random,chase,zipf");
+	} else {
+		workloads = splitList(WorkloadName);
+	}
+	std::vector<string> sizes = splitList(Sizes);
+	std::vector<string> assocs = splitList(Assocs);
+	const size_t CHUNK = 1 << 16;
+	std::vector<TraceRecord> records(CHUNK);
+	for (unsigned w = 0; w < workloads.size(); w++) {
+		for (unsigned s = 0; s < sizes.size(); s++) {
+			unsigned l1Size = 0, l2Size = 0;
+			if (sscanf(sizes[s].c_str(), "%u/%u", &l1Size, &l2Size) != 2) {
+				cerr << "Error in arguments" << endl;
+				return 0;
+			}
+			for (unsigned a = 0; a < assocs.size(); a++) {
+				SimConfig run = cfg;
+				run.levels[0].Size = l1Size;
+				run.levels[1].Size = l2Size;
+				run.levels[0].Assoc = run.levels[1].Assoc = atoi(assocs[a].c_str());
+				if (l1Size < cfg.BSize + run.levels[0].Assoc || l2Size < cfg.BSize + run.levels[1].Assoc) {
+					continue; // more ways than blocks
+				}
+				if (!checkSimConfig(run)) {
+					cerr << "Error in arguments" << endl;
+					return 0;
+				}
+				Workload workload(workloads[w], Footprint, cfg.BSize, Stride, Seed);
+				if (!workload.valid()) {
+					cerr << "Unknown workload " << workloads[w] << endl;
+					return 0;
+				}
+				CacheSystem cacheSystem(run);
+				// only the access loop is timed, the stream is generated chunk by chunk outside it
+				double seconds = 0;
+				for (unsigned long long done = 0; done < Accesses;) {
+					size_t count = (size_t)std::min<unsigned long long>(CHUNK, Accesses - done);
+					workload.generate(records.data(), count);
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					for (size_t i = 0; i < count; i++) {
+						cacheSystem.access(records[i].address, records[i].operation);
+					}
+					seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					done += count;
+				}
+				CacheStats stats = cacheSystem.getStats();
+				printf("workload=%s l1-size=%u l2-size=%u assoc=%u accesses=%llu seconds=%.03f Maccess/s=%.03f",
+				       workloads[w].c_str(), l1Size, l2Size, run.levels[0].Assoc, Accesses, seconds,
+				       (float)(seconds > 0 ? Accesses / seconds / 1e6 : 0));
+				printf(" L1miss=%.03f L2miss=%.03f\n", (float)(stats.misses[0] / stats.accesses[0]),
+				       (float)(stats.accesses[1] ? stats.misses[1] / stats.accesses[1] : 0));
+				fflush(stdout);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,290 @@
+// course - Computer Architecture 046267
+// hw-2 cache simulator - cache model library (out of line parts and the C ABI)
+/*------------------------------------------------*/
+#include <cstring>
+#include <sstream>
+#include "cacheSim.h"
+using std::string;
+using std::stringstream;
+
+// parse one trace line "<op> 0x<address>" - shared by cacheSim and the trace tools
+bool parseTraceLine(const string& line, char& operation, unsigned long& num) {
+	stringstream ss(line);
+	string address;
+	if (!(ss >> operation >> address)) {
+		return false;
+	}
+	string cutAddress = address.substr(2); // Removing the "0x" part of the address
+	num = strtoul(cutAddress.c_str(), NULL, 16);
+	return true;
+}
+// trace line with a third field, a missing field reads as 0
+bool parseTraceLine(const string& line, char& operation, unsigned long& num, unsigned long& field) {
+	if (!parseTraceLine(line, operation, num)) {
+		return false;
+	}
+	stringstream ss(line);
+	string skip;
+	ss >> skip >> skip;
+	if (!(ss >> field)) {
+		field = 0;
+	}
+	return true;
+}
+
+// inclusion policy by name or number, -1 if unknown
+static int parseInclusion(const string& value) {
+	if (value == "nine" || value == "0") {
+		return INCL_NINE;
+	} else if (value == "inclusive" || value == "1") {
+		return INCL_INCLUSIVE;
+	} else if (value == "exclusive" || value == "2") {
+		return INCL_EXCLUSIVE;
+	}
+	return -1;
+}
+
+// parse one cache system flag, false if the flag is not a cache system flag
+// level flags are --l<k>-size/assoc/cyc/wr-alloc/incl/index/mshr/pf, a higher k adds levels
+bool parseSimOption(const string& s, const char* value, SimConfig& cfg) {
+	if (s == "--mem-cyc") {
+		cfg.MemCyc = atoi(value);
+		return true;
+	} else if (s == "--bsize") {
+		cfg.BSize = atoi(value);
+		return true;
+	} else if (s == "--wr-alloc") {
+		cfg.WrAlloc = atoi(value);
+		return true;
+	} else if (s == "--pf-degree") {
+		cfg.PfDegree = atoi(value);
+		return true;
+	} else if (s == "--pf-queue") {
+		cfg.PfQueue = atoi(value);
+		return true;
+	} else if (s == "--pf-latency") {
+		cfg.PfLatency = atoi(value);
+		return true;
+	} else if (s == "--vc-entries") {
+		cfg.VcEntries = atoi(value);
+		return (cfg.VcEntries & (cfg.VcEntries - 1)) == 0; // power of 2
+	} else if (s == "--vc-cyc") {
+		cfg.VcCyc = atoi(value);
+		return true;
+	} else if (s == "--wb-entries") {
+		cfg.WbEntries = atoi(value);
+		return true;
+	} else if (s == "--wb-cyc") {
+		cfg.WbCyc = atoi(value);
+		return true;
+	} else if (s == "--timing") {
+		cfg.Timing = atoi(value);
+		return true;
+	} else if (s == "--issue-rate") {
+		cfg.IssueRate = atoi(value);
+		return true;
+	} else if (s == "--dram") {
+		cfg.Dram = atoi(value);
+		return true;
+	} else if (s == "--dram-channels") {
+		cfg.DramChannels = atoi(value);
+		return true;
+	} else if (s == "--dram-banks") {
+		cfg.DramBanks = atoi(value);
+		return true;
+	} else if (s == "--dram-row") {
+		cfg.DramRow = atoi(value);
+		return true;
+	} else if (s == "--dram-trcd") {
+		cfg.DramTRCD = atoi(value);
+		return true;
+	} else if (s == "--dram-tcas") {
+		cfg.DramTCAS = atoi(value);
+		return true;
+	} else if (s == "--dram-trp") {
+		cfg.DramTRP = atoi(value);
+		return true;
+	} else if (s == "--dram-tburst") {
+		cfg.DramTBurst = atoi(value);
+		return true;
+	} else if (s == "--dram-page") {
+		cfg.DramPage = value;
+		return cfg.DramPage == "open" || cfg.DramPage == "closed";
+	} else if (s == "--dram-map") {
+		cfg.DramMap = value;
+		return cfg.DramMap == "row" || cfg.DramMap == "block";
+	} else if (s == "--traffic") {
+		cfg.Traffic = atoi(value);
+		return true;
+	} else if (s == "--mem-bw") {
+		cfg.MemBandwidth = atof(value);
+		return cfg.MemBandwidth >= 0;
+	} else if (s == "--inclusion") {
+		cfg.Inclusion = parseInclusion(value);
+		return cfg.Inclusion >= 0;
+	} else if (s == "--sample-ratio") {
+		cfg.SampleRatio = atoi(value);
+		return cfg.SampleRatio > 0;
+	} else if (s == "--3c") {
+		cfg.ThreeC = atoi(value);
+		return true;
+	} else if (s == "--l1i-size") {
+		cfg.L1ISize = atoi(value);
+		return true;
+	} else if (s == "--l1i-assoc") {
+		cfg.L1IAssoc = atoi(value);
+		return true;
+	} else if (s == "--l1i-cyc") {
+		cfg.L1ICyc = atoi(value);
+		return true;
+	} else if (s == "--levels") {
+		unsigned n = atoi(value);
+		if (n < 1 || n > 8) {
+			return false;
+		}
+		cfg.levels.resize(n);
+		return true;
+	}
+	unsigned k = 0;
+	char field[16] = {0};
+	if (sscanf(s.c_str(), "--l%u-%15s", &k, field) != 2 || k < 1 || k > 8) {
+		return false;
+	}
+	if (k > cfg.levels.size()) {
+		cfg.levels.resize(k);
+	}
+	LevelConfig& lv = cfg.levels[k - 1];
+	string f(field);
+	if (f == "size") {
+		lv.Size = atoi(value);
+	} else if (f == "assoc") {
+		lv.Assoc = atoi(value);
+	} else if (f == "cyc") {
+		lv.Cyc = atoi(value);
+	} else if (f == "wr-alloc") {
+		lv.WrAlloc = atoi(value);
+	} else if (f == "incl") {
+		lv.Inclusive = parseInclusion(value);
+		if (lv.Inclusive < 0 || (k == 1 && lv.Inclusive == INCL_EXCLUSIVE)) {
+			return false; // nothing above L1 to be exclusive of
+		}
+	} else if (f == "index") {
+		string fn(value);
+		if (fn == "bits") {
+			lv.Index = INDEX_BITS;
+		} else if (fn == "xor") {
+			lv.Index = INDEX_XOR;
+		} else if (fn == "prime") {
+			lv.Index = INDEX_PRIME;
+		} else if (fn == "skew") {
+			lv.Index = INDEX_SKEW;
+		} else {
+			return false;
+		}
+	} else if (f == "mshr") {
+		lv.Mshr = atoi(value);
+	} else if (f == "pf") {
+		lv.Prefetch = value;
+		if (lv.Prefetch != "none" && lv.Prefetch != "next" && lv.Prefetch != "stride" && lv.Prefetch != "delta") {
+			return false;
+		}
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool checkSimConfig(const SimConfig& cfg) {
+	// every cache needs at least one set - the set bits are size - block - assoc
+	if (cfg.L1ISize > 0 && cfg.L1ISize < cfg.BSize + cfg.L1IAssoc) {
+		return false;
+	}
+	for (unsigned k = 0; k < cfg.levels.size(); k++) {
+		if (cfg.levels[k].Size == 0 || cfg.levels[k].Size < cfg.BSize + cfg.levels[k].Assoc) {
+			return false; // a level added by --levels or a higher --l<k> flag needs its size
+		}
+		if (cfg.SampleRatio > 1 && cfg.levels[k].Index != INDEX_BITS) {
+			return false; // sampled sets are picked from the plain index bits every level shares
+		}
+	}
+	return true;
+}
+
+bool checkMultiCoreConfig(const SimConfig& cfg) {
+	if (cfg.levels.size() < 2 || cfg.VcEntries || cfg.WbEntries || cfg.ThreeC || cfg.SampleRatio > 1 || cfg.Timing ||
+	    cfg.Dram || cfg.Traffic || cfg.MemBandwidth > 0 || cfg.L1ISize) {
+		return false;
+	}
+	for (unsigned k = 0; k < cfg.levels.size(); k++) {
+		if (levelInclusion(cfg, k) == INCL_EXCLUSIVE || cfg.levels[k].Prefetch != "none") {
+			return false;
+		}
+	}
+	return true;
+}
+
+Prefetcher* makePrefetcher(const string& kind, unsigned degree) {
+    if (kind == "next") {
+        return new NextLinePrefetcher(degree);
+    } else if (kind == "stride") {
+        return new StridePrefetcher(degree);
+    } else if (kind == "delta") {
+        return new DeltaPrefetcher(degree);
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------------*/
+// C ABI - an opaque handle around CacheSystem
+struct cache_sim {
+    CacheSystem system;
+    cache_sim(const SimConfig& cfg) : system(cfg) {}
+};
+
+cache_sim* cache_sim_create(const char* options) {
+    SimConfig cfg;
+    stringstream ss(options ? options : "");
+    string flag, value;
+    while (ss >> flag) {
+        if (!(ss >> value) || !parseSimOption(flag, value.c_str(), cfg)) {
+            return NULL;
+        }
+    }
+    if (!checkSimConfig(cfg)) {
+        return NULL;
+    }
+    return new cache_sim(cfg);
+}
+
+void cache_sim_destroy(cache_sim* sim) {
+    delete sim;
+}
+
+void cache_sim_access(cache_sim* sim, uint64_t address, char operation) {
+    sim->system.access(address, operation);
+}
+
+static void toCStats(const CacheStats& in, cache_stats* out) {
+    memset(out, 0, sizeof(*out));
+    out->levels = in.levels;
+    for (unsigned k = 0; k < in.levels && k < CACHE_MAX_LEVELS; k++) {
+        out->accesses[k] = in.accesses[k];
+        out->misses[k] = in.misses[k];
+        out->writebacks[k] = in.writebacks[k];
+    }
+    out->total_time = in.totalTime;
+}
+
+void cache_sim_access_batch(cache_sim* sim, const cache_access* records, size_t count, cache_stats* stats) {
+    for (size_t i = 0; i < count; i++) {
+        sim->system.access(records[i].address, records[i].operation);
+    }
+    if (stats) {
+        toCStats(sim->system.getStats(), stats);
+    }
+}
+
+void cache_sim_get_stats(const cache_sim* sim, cache_stats* stats) {
+    toCStats(sim->system.getStats(), stats);
+}
+/*--------------------------------------------------------------------------------------------------------------------------------*/
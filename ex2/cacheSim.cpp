@@ -7,290 +7,249 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <vector>
-#include <cmath>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "cacheSim.h"
 using std::FILE;
 using std::string;
 using std::cout;
 using std::endl;
 using std::cerr;
 using std::ifstream;
+using std::istream;
+using std::cin;
 using std::stringstream;
 using namespace std;
-#define ADDRESS_SIZE 32 //address is 32 bit long
-/*--------------------------------------------------------------------------------------------------------*/
- //define struct cache block
-struct cacheBlock {
-    unsigned tag = 0; // tag
-    bool valid = 0; // valid bit
-    bool dirty = 0; // dirty bit 
-    unsigned evictCount = 0; // evicted counter lru
-};
-
-// class cache level 
-class Cache {
+// buffered writer for the interval records - one fwrite per filled buffer
+class IntervalWriter {
 private:
-    unsigned cacheSize; // size
-    unsigned blockSize, assoc; // block size ans assoc
-    unsigned accessTime; // access time 
-    unsigned num_of_sets; //number of sets
-    unsigned num_of_ways; //number of ways
-    unsigned set_size; // set size in bits
-    unsigned offset_size; //offset size in bits
-    unsigned tag_size; // tag size in bits
-    vector<vector<cacheBlock>> blocks; // vector of vector of blocks
-
+    FILE* out;
+    string buffer;
+    static const size_t FLUSH_SIZE = 1 << 16;
 public:
-// consrtuctor
-    Cache(unsigned cacheSize, unsigned blockSize, unsigned assoc, unsigned accessTime)
-        : cacheSize(cacheSize), blockSize(blockSize), assoc(assoc), accessTime(accessTime) {
-        set_size = cacheSize - blockSize - assoc; // calc of set size - can be shown log2 of num of sets
-        num_of_sets = 1 << set_size; // pow2
-        num_of_ways = 1 << assoc; // pow2
-        offset_size = blockSize; // in bits- log2(bytes)
-        tag_size = ADDRESS_SIZE - offset_size - set_size; // calc    
-        blocks.resize(num_of_sets, vector<cacheBlock>(num_of_ways)); //resize vector of vectors
+    IntervalWriter(const string& path) : out(fopen(path.c_str(), "w")) {
+        buffer.reserve(2 * FLUSH_SIZE);
+    }
+    ~IntervalWriter() {
+        flush();
+        if (out) {
+            fclose(out);
+        }
+    }
+    bool good() const {
+        return out != NULL;
+    }
+    void write(const string& record) {
+        buffer += record;
+        if (buffer.size() >= FLUSH_SIZE) {
+            flush();
+        }
+    }
+    void flush() {
+        if (out && !buffer.empty()) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+        }
+        buffer.clear();
     }
+};
 
-    // Check for hit
-    bool checkHit(unsigned address, unsigned& way_index) {
-        unsigned index = (address >> offset_size) & ((1 << set_size) - 1); // calc index
-        unsigned tag = address >> (offset_size + set_size); // calc tag
-         // look for hit    
-        for (unsigned i = 0; i < num_of_ways; i++) {
-            if (blocks[index][i].valid && blocks[index][i].tag == tag) {
-                way_index = i;
+// run many independent cache systems over one decoded trace
+// every worker owns a job queue, pops from its front and steals from the back of the others
+class SweepPool {
+private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<unsigned> jobs;
+    };
+    const vector<TraceRecord>& trace;
+    const vector<SimConfig>& configs;
+    vector<string>& results;
+    vector<WorkQueue> queues;
+
+    bool popJob(unsigned worker, unsigned& job) {
+        {
+            std::lock_guard<std::mutex> guard(queues[worker].lock);
+            if (!queues[worker].jobs.empty()) {
+                job = queues[worker].jobs.front();
+                queues[worker].jobs.pop_front();
                 return true;
             }
         }
-        return false;
-    }
-    // Find invalid way- empty block
-    bool findInvalidWay(unsigned index, unsigned& way_index) {
-        for (unsigned i = 0; i < num_of_ways; i++) {
-            if (!blocks[index][i].valid) {
-                way_index = i;
+        // own queue is empty - steal
+        for (unsigned k = 1; k < queues.size(); k++) {
+            WorkQueue& victim = queues[(worker + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
                 return true;
             }
         }
         return false;
     }
-    // find oldest - by lru alg
-    void findByEvictedCount(unsigned index, unsigned& way_index) {
-        for (unsigned i = 0; i < num_of_ways; i++) {
-            if (blocks[index][i].evictCount == 0) {
-                way_index = i;
-                break;
+    void worker(unsigned id) {
+        unsigned job;
+        while (popJob(id, job)) {
+            CacheSystem cacheSystem(configs[job]);
+            for (unsigned i = 0; i < trace.size(); i++) {
+                cacheSystem.access(trace[i].address, trace[i].operation);
             }
+            CACHE_PROFILE_RECORDS(trace.size());
+            results[job] = cacheSystem.statistics(); // each job owns its slot
         }
-        return;
     }
 
-    // Update evicted counter
-    void updateLRU(unsigned index, unsigned way_index) {
-        unsigned x = blocks[index][way_index].evictCount;
-        blocks[index][way_index].evictCount = num_of_ways - 1; 
-        for (unsigned j = 0; j < num_of_ways; j++) {
-            if (j != way_index && blocks[index][j].evictCount > x) {
-                blocks[index][j].evictCount--;
-            }
+public:
+    SweepPool(const vector<TraceRecord>& trace, const vector<SimConfig>& configs,
+              vector<string>& results, unsigned threads)
+        : trace(trace), configs(configs), results(results), queues(threads) {
+        results.assign(configs.size(), "");
+        for (unsigned i = 0; i < configs.size(); i++) {
+            queues[i % threads].jobs.push_back(i);
         }
-        return;
     }
-
-    // Insert block into cache
-    void insertBlock(unsigned address, unsigned way, bool isDirty) {
-        unsigned index = (address >> offset_size) & ((1 << set_size) - 1);
-        unsigned tag = address >> (offset_size + set_size);
-        blocks[index][way].valid = true;
-        blocks[index][way].tag = tag;
-        blocks[index][way].dirty = isDirty;
-    }
-
-    // Invalidate block
-    bool invalidate(unsigned address) {
-        unsigned index = (address >> offset_size) & ((1 << set_size) - 1);
-        unsigned tag = address >> (offset_size + set_size);
-        
-        for (unsigned i = 0; i < num_of_ways; i++) {
-            if (blocks[index][i].valid && blocks[index][i].tag == tag) {
-                bool wasDirty = blocks[index][i].dirty;
-                blocks[index][i].valid = false;
-                blocks[index][i].dirty = false;
-                return wasDirty;
-            }
+    void run() {
+        vector<std::thread> workers;
+        for (unsigned i = 1; i < queues.size(); i++) {
+            workers.push_back(std::thread(&SweepPool::worker, this, i));
+        }
+        worker(0);
+        for (unsigned i = 0; i < workers.size(); i++) {
+            workers[i].join();
         }
-        return false;
-    }
-
-    // Get block address?
-    unsigned getBlockAddress(unsigned index, unsigned way_index) {
-        return (blocks[index][way_index].tag << (set_size + offset_size)) | (index << offset_size);
-    }
-
-    // Check dirty
-    bool isDirty(unsigned index, unsigned way_index) {
-        return blocks[index][way_index].dirty;
     }
+};
 
-    // Set dirty 
-    void setDirty(unsigned index, unsigned way_index) {
-        blocks[index][way_index].dirty = true;
-    }
-    // get access time 
-    unsigned getAccessTime() const { 
-        return accessTime; 
-    }
-    // get index of address
-    unsigned getIndex(unsigned address) {
-        return (address >> offset_size) & ((1 << set_size) - 1);
-    }
+// the model keeps ADDRESS_SIZE bits of every address - warn once when the trace is wider
+void checkAddressWidth(unsigned long num) {
+#if ADDRESS_SIZE < 64
+	static bool warned = false;
+	if (!warned && ((unsigned long long)num >> ADDRESS_SIZE) != 0) {
+		cerr << "Warning: addresses wider than " << ADDRESS_SIZE << " bits are truncated, build with ADDR64=1" << endl;
+		warned = true;
+	}
+#else
+	(void)num;
+#endif
+}
 
-    // Check if block is valid
-    bool isValid(unsigned index, unsigned way_index) {
-        return blocks[index][way_index].valid;
-    }
+// decoded trace line - the third field is the core id or the issue cycle when asked for
+struct TraceEntry {
+    unsigned long address;
+    unsigned long field;
+    char operation;
 };
-// calss cachesystem
-class CacheSystem {
-private:
-    unsigned memCycle;
-    unsigned wrAlloc;
-    Cache L1, L2;
-    double totalTime;
-    double missesL1;
-    double missesL2;
-    double accessesL1;
-    double accessesL2;
 
-public:
-    CacheSystem(unsigned memCycle, unsigned blockSize, unsigned L1Size, unsigned L2Size, unsigned L1Assoc, unsigned L2Assoc,
-                unsigned L1Cycles, unsigned L2Cycles, unsigned wrAlloc)
-        : memCycle(memCycle),
-          wrAlloc(wrAlloc),
-          L1(L1Size, blockSize, L1Assoc, L1Cycles),
-          L2(L2Size, blockSize, L2Assoc, L2Cycles),
-          totalTime(0),
-          missesL1(0), 
-          missesL2(0), 
-          accessesL1(0), 
-          accessesL2(0) {}
-    // access to memory hir
-    void access(unsigned address, char operation) {
-        accessesL1++;//update l1 
-        totalTime += L1.getAccessTime();//update total time
-        unsigned updateLru2 =false; 
-        bool snoop =false;
-        unsigned evictedAddr;
-        unsigned evictedAddr2; 
-        bool  bylru=false;
-        unsigned way1_index = 0;
-        //check for hit 
-        bool hit1 = L1.checkHit(address, way1_index);
-        if (hit1) {
-            if (operation == 'w') {
-                L1.setDirty(L1.getIndex(address), way1_index);
-            }
-            L1.updateLRU(L1.getIndex(address), way1_index);
-            return;
-        }
-        /////// miss l1/////
-        missesL1++;// mis l1 
-        accessesL2++;
-        totalTime += L2.getAccessTime();
+// background trace decoder - a reader thread parses the input (file, fifo or stdin) into
+// batches of entries and hands them to the simulation thread through a single producer /
+// single consumer ring, so reading, parsing and simulating overlap
+class TraceReader {
+private:
+    static const size_t BATCH = 1 << 14; // entries per batch
+    static const size_t SLOTS = 8; // batches in flight
+    struct Batch {
+        vector<TraceEntry> entries;
+        size_t count;
+    };
+    // everything the reader thread touches - shared with it, so a reader left blocked on a
+    // pipe when the consumer quits early never sees the state freed under it
+    struct State {
+        istream& in;
+        bool withField;
+        vector<Batch> slots;
+        std::atomic<size_t> head; // next batch the consumer takes, written by the consumer only
+        std::atomic<size_t> tail; // next batch the producer fills, written by the producer only
+        std::atomic<bool> done;
+        std::atomic<bool> stop; // the consumer quit early
+        bool malformed; // published by done
+        State(istream& in, bool withField)
+            : in(in), withField(withField), slots(SLOTS), head(0), tail(0), done(false), stop(false),
+              malformed(false) {}
+    };
+    std::shared_ptr<State> state;
+    bool holding; // the consumer still reads slots[head]
+    std::thread producer;
 
-        unsigned way2_index = 0;
-        //check hit l2
-        bool hit2 = L2.checkHit(address, way2_index);
-        //mis
-        if (!hit2) {
-            // L2 Miss
-            missesL2++;
-            totalTime += memCycle;
-            
-            if (wrAlloc == 1 || operation == 'r') {
-                // Allocate in L2
-                unsigned indexL2 = L2.getIndex(address);
-                unsigned way_index=0;
-                bool l2AllocWay = L2.findInvalidWay(indexL2, way_index); // find invalid
-                
-                if (!l2AllocWay) {
-                    // L2 full
-                    L2.findByEvictedCount(indexL2, way_index); // find evicted- lru
-                }
-                if (L2.isValid(indexL2, way_index)) {
-                        //  invalidate from L1
-                    unsigned evictedAddr = L2.getBlockAddress(indexL2, way_index);
-                    bool wasDirty = L1.invalidate(evictedAddr);
-                        
-                    if (wasDirty) {
-                        // Update L2 LRU for dirty eviction
-                        //updateL2LRU(evictedAddr);
-                        snoop=true; // fir snoop
-                    }
+    static void produce(std::shared_ptr<State> s) {
+        string line;
+        for (size_t t = 0; !s->stop.load(std::memory_order_relaxed); t++) {
+            while (t - s->head.load(std::memory_order_acquire) == SLOTS) {
+                if (s->stop.load(std::memory_order_relaxed)) {
+                    break;
                 }
-                
-                L2.insertBlock(address, way_index, false); // update l2 block
-                way2_index = way_index;
-                updateLru2=true;
+                std::this_thread::yield(); // ring full
             }
-        }
-
-        if (wrAlloc == 1 || operation == 'r') {
-            // Allocate in L1
-            unsigned indexL1 = L1.getIndex(address);
-            unsigned way_index1=0;
-            bool l1AllocWay = L1.findInvalidWay(indexL1, way_index1);
-            
-            if (!l1AllocWay) {
-                // L1 full, evict LRU
-                L1.findByEvictedCount(indexL1, way_index1);
-                
-                if (L1.isValid(indexL1, way_index1) && L1.isDirty(indexL1, way_index1)) {
-                    // Dirty eviction from L1 - update L2
-                    evictedAddr2 = L1.getBlockAddress(indexL1, way_index1);
-                    //updateL2LRU(evictedAddr2);
-                    bylru=true;
+            if (t - s->head.load(std::memory_order_acquire) == SLOTS) {
+                break;
+            }
+            Batch& batch = s->slots[t % SLOTS];
+            batch.count = 0;
+            CACHE_PROFILE_SCOPE(PROF_DECODE); // per batch, the wait for a free slot is left out
+            while (batch.count < BATCH && getline(s->in, line)) {
+                TraceEntry& e = batch.entries[batch.count];
+                e.field = 0;
+                bool ok = s->withField ? parseTraceLine(line, e.operation, e.address, e.field)
+                                       : parseTraceLine(line, e.operation, e.address);
+                if (!ok) {
+                    s->malformed = true;
+                    break;
                 }
+                batch.count++;
+            }
+            if (batch.count > 0) {
+                s->tail.store(t + 1, std::memory_order_release);
+            }
+            if (batch.count < BATCH) {
+                break; // end of input or a bad line
             }
-            
-            bool isDirty = (operation == 'w');
-            L1.insertBlock(address, way_index1, isDirty); //update l1 block
-            L1.updateLRU(indexL1, way_index1); // update lru of 1
-        }
-        
-        // Update L2 LRU if we accessed it
-        if (updateLru2 || hit2) {
-            L2.updateLRU(L2.getIndex(address), way2_index);
         }
-        if(snoop){
-            updateL2LRU(evictedAddr); // snoop
+        s->done.store(true, std::memory_order_release);
+    }
+
+public:
+    TraceReader(istream& in, bool withField) : state(std::make_shared<State>(in, withField)), holding(false) {
+        for (size_t i = 0; i < SLOTS; i++) {
+            state->slots[i].entries.resize(BATCH);
+            state->slots[i].count = 0;
         }
-        if(bylru){
-             updateL2LRU(evictedAddr2);// dirty update 
+        producer = std::thread(&TraceReader::produce, state);
+    }
+    ~TraceReader() {
+        state->stop.store(true, std::memory_order_relaxed);
+        if (state->done.load(std::memory_order_acquire)) {
+            producer.join();
+        } else {
+            // quit early (bad line, bad core id) - the reader may sit in a blocking read of a
+            // pipe or fifo that never ends, it is left to the process exit instead of a join
+            producer.detach();
         }
-        
     }
-// update lru 2 by snoop or dirty 
-    void updateL2LRU(unsigned address) {
-        // Snoop operation - zero time cost
-        unsigned way;
-        bool l2Way_hit = L2.checkHit(address, way);
-        if (l2Way_hit) {
-            L2.updateLRU(L2.getIndex(address), way);
+    // next batch of entries, NULL at the end of the input - valid until the next call
+    const TraceEntry* next(size_t& count) {
+        size_t h = state->head.load(std::memory_order_relaxed);
+        if (holding) {
+            state->head.store(++h, std::memory_order_release);
+            holding = false;
+        }
+        while (state->tail.load(std::memory_order_acquire) == h) {
+            if (state->done.load(std::memory_order_acquire) && state->tail.load(std::memory_order_acquire) == h) {
+                return NULL;
+            }
+            std::this_thread::yield();
         }
+        holding = true;
+        count = state->slots[h % SLOTS].count;
+        return state->slots[h % SLOTS].entries.data();
     }
-    //print statistics
-    void print_statistics() const {
-        printf("L1miss=%.03f ", (float)missesL1 / accessesL1);
-        printf("L2miss=%.03f ", (float)missesL2 / accessesL2);
-        printf("AccTimeAvg=%.03f\n", (float)totalTime / accessesL1);
+    // the input stopped at a line that is not a trace line (valid once next returned NULL)
+    bool bad() const {
+        return state->malformed;
     }
 };
-/*-------------------------------------------------------------------------------------------------------*/
 int main(int argc, char **argv) {
 
-	if (argc < 19) {
+	if (argc < 2) {
 		cerr << "Not enough arguments" << endl;
 		return 0;
 	}
@@ -298,68 +257,287 @@ int main(int argc, char **argv) {
 	// File
 	// Assuming it is the first argument
 	char* fileString = argv[1];
-	ifstream file(fileString); //input file stream
-	string line;
-	if (!file || !file.good()) {
-		// File doesn't exist or some other error
-		cerr << "File not found" << endl;
-		return 0;
+	// "-" reads the trace from stdin, a fifo path works like a file
+	bool fromStdin = (string(fileString) == "-");
+	ifstream file; //input file stream
+	if (fromStdin) {
+		std::ios::sync_with_stdio(false);
+	} else {
+		file.open(fileString);
+		if (!file || !file.good()) {
+			// File doesn't exist or some other error
+			cerr << "File not found" << endl;
+			return 0;
+		}
 	}
-	unsigned MemCyc = 0, BSize = 0, L1Size = 0, L2Size = 0, L1Assoc = 0,
-			L2Assoc = 0, L1Cyc = 0, L2Cyc = 0, WrAlloc = 0;
-	for (int i = 2; i < 19; i += 2) {
+	istream& input = fromStdin ? cin : file;
+	string line;
+	SimConfig cfg;
+	// stack distance mode - all l1 sizes in one pass
+	unsigned StackDist = 0, MinSets = 0, MaxSets = 0, MaxAssoc = 4;
+	// sweep mode - one row per line of the sweep file
+	string SweepFile;
+	unsigned Threads = std::thread::hardware_concurrency();
+	bool ConfigFile = false;
+	// multi core mode - private L1s, shared lower levels, mesi
+	unsigned Cores = 0;
+	// interval statistics every N accesses, csv or json lines
+	unsigned long Interval = 0;
+	string IntervalFile = "intervals.csv", IntervalFormat = "csv";
+	// checkpoint after N trace lines / restore at startup (skips the lines it covers)
+	unsigned long CheckpointAt = 0;
+	string CheckpointFile, RestoreFile;
+	unsigned ResetStats = 0;
+	// timing mode - issue cycles taken from the third trace field
+	unsigned Timestamps = 0;
+	for (int i = 2; i < argc; i += 2) {
 		string s(argv[i]);
-		if (s == "--mem-cyc") {
-			MemCyc = atoi(argv[i + 1]);
-		} else if (s == "--bsize") {
-			BSize = atoi(argv[i + 1]);
-		} else if (s == "--l1-size") {
-			L1Size = atoi(argv[i + 1]);
-		} else if (s == "--l2-size") {
-			L2Size = atoi(argv[i + 1]);
-		} else if (s == "--l1-cyc") {
-			L1Cyc = atoi(argv[i + 1]);
-		} else if (s == "--l2-cyc") {
-			L2Cyc = atoi(argv[i + 1]);
-		} else if (s == "--l1-assoc") {
-			L1Assoc = atoi(argv[i + 1]);
-		} else if (s == "--l2-assoc") {
-			L2Assoc = atoi(argv[i + 1]);
-		} else if (s == "--wr-alloc") {
-			WrAlloc = atoi(argv[i + 1]);
+		if (i + 1 >= argc) {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+		if (parseSimOption(s, argv[i + 1], cfg)) {
+			continue;
+		} else if (s == "--stack-dist") {
+			StackDist = atoi(argv[i + 1]);
+		} else if (s == "--min-sets") {
+			MinSets = atoi(argv[i + 1]);
+		} else if (s == "--max-sets") {
+			MaxSets = atoi(argv[i + 1]);
+		} else if (s == "--max-assoc") {
+			MaxAssoc = atoi(argv[i + 1]);
+		} else if (s == "--config") {
+			// hierarchy config file - same flags as the command line, # starts a comment
+			ifstream config(argv[i + 1]);
+			if (!config) {
+				cerr << "File not found" << endl;
+				return 0;
+			}
+			while (getline(config, line)) {
+				stringstream ss(line.substr(0, line.find('#')));
+				string flag, value;
+				while (ss >> flag) {
+					if (!(ss >> value) || !parseSimOption(flag, value.c_str(), cfg)) {
+						cerr << "Error in arguments" << endl;
+						return 0;
+					}
+				}
+			}
+			ConfigFile = true;
+		} else if (s == "--sweep") {
+			SweepFile = argv[i + 1];
+		} else if (s == "--interval") {
+			Interval = strtoul(argv[i + 1], NULL, 10);
+		} else if (s == "--interval-out") {
+			IntervalFile = argv[i + 1];
+		} else if (s == "--interval-format") {
+			IntervalFormat = argv[i + 1];
+			if (IntervalFormat != "csv" && IntervalFormat != "json") {
+				cerr << "Error in arguments" << endl;
+				return 0;
+			}
+		} else if (s == "--checkpoint-at") {
+			CheckpointAt = strtoul(argv[i + 1], NULL, 10);
+		} else if (s == "--checkpoint-out") {
+			CheckpointFile = argv[i + 1];
+		} else if (s == "--restore") {
+			RestoreFile = argv[i + 1];
+		} else if (s == "--timestamps") {
+			Timestamps = atoi(argv[i + 1]);
+		} else if (s == "--reset-stats") {
+			ResetStats = atoi(argv[i + 1]);
+		} else if (s == "--cores") {
+			Cores = atoi(argv[i + 1]);
+		} else if (s == "--threads") {
+			Threads = atoi(argv[i + 1]);
 		} else {
 			cerr << "Error in arguments" << endl;
 			return 0;
 		}
 	}
-	CacheSystem cacheSystem(MemCyc, BSize, L1Size, L2Size, L1Assoc, L2Assoc,
-                L1Cyc, L2Cyc, WrAlloc);
-	while (getline(file, line)) {
-		stringstream ss(line);
-		string address;
-		char operation = 0; // read (R) or write (W)
-		if (!(ss >> operation >> address)) {
-			// Operation appears in an Invalid format
+	if (!checkSimConfig(cfg)) {
+		cerr << "Error in arguments" << endl;
+		return 0;
+	}
+	if (StackDist) {
+		// sets and assoc are log2 like the other flags
+		if (MinSets > MaxSets || MaxSets > 24 || MaxAssoc > 16) {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+		StackDistance stackDist(cfg.BSize, MinSets, MaxSets, MaxAssoc);
+		TraceReader reader(input, false);
+		size_t n = 0;
+		while (const TraceEntry* batch = reader.next(n)) {
+			for (size_t j = 0; j < n; j++) {
+				stackDist.access(batch[j].address);
+			}
+			CACHE_PROFILE_RECORDS(n);
+		}
+		if (reader.bad()) {
 			cout << "Command Format error" << endl;
 			return 0;
 		}
-		// DEBUG - remove this line
-		//cout << "operation: " << operation;
-		string cutAddress = address.substr(2); // Removing the "0x" part of the address
-		// DEBUG - remove this line
-		//cout << ", address (hex)" << cutAddress;
-		unsigned long int num = 0;
-		num = strtoul(cutAddress.c_str(), NULL, 16);
-		// DEBUG - remove this line
-		//cout << " (dec) " << num << endl;
-		cacheSystem.access(num, operation);
+		stackDist.print_statistics();
+		return 0;
+	}
+	if (!SweepFile.empty()) {
+		// each sweep line holds cache system flags, missing flags default to the command line ones
+		ifstream sweep(SweepFile.c_str());
+		if (!sweep) {
+			cerr << "File not found" << endl;
+			return 0;
+		}
+		vector<SimConfig> configs;
+		vector<string> names;
+		while (getline(sweep, line)) {
+			stringstream ss(line);
+			string flag, value;
+			SimConfig c = cfg;
+			while (ss >> flag) {
+				if (!(ss >> value) || !parseSimOption(flag, value.c_str(), c)) {
+					cerr << "Error in arguments" << endl;
+					return 0;
+				}
+			}
+			if (!checkSimConfig(c)) {
+				cerr << "Error in arguments" << endl;
+				return 0;
+			}
+			if (!line.empty()) {
+				configs.push_back(c);
+				names.push_back(line);
+			}
+		}
+		// decode the trace once
+		vector<TraceRecord> trace;
+		TraceReader reader(input, false);
+		size_t n = 0;
+		while (const TraceEntry* batch = reader.next(n)) {
+			for (size_t j = 0; j < n; j++) {
+				TraceRecord rec;
+				rec.address = batch[j].address;
+				rec.operation = batch[j].operation;
+				checkAddressWidth(rec.address);
+				trace.push_back(rec);
+			}
+		}
+		if (reader.bad()) {
+			cout << "Command Format error" << endl;
+			return 0;
+		}
+		if (Threads == 0) {
+			Threads = 1;
+		}
+		vector<string> results;
+		SweepPool pool(trace, configs, results, Threads);
+		pool.run();
+		for (unsigned i = 0; i < configs.size(); i++) {
+			printf("%s %s\n", names[i].c_str(), results[i].c_str());
+		}
+		return 0;
+	}
+	if (argc < 19 && !ConfigFile) {
+		cerr << "Not enough arguments" << endl;
+		return 0;
+	}
+	if (Cores > 0) {
+		// private L1s and mesi only - no interval, checkpoint or timing mode options either
+		if (!checkMultiCoreConfig(cfg) || Interval || CheckpointAt || !RestoreFile.empty() || Timestamps ||
+		    ResetStats) {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+		MultiCoreSystem multiCore(cfg, Cores);
+		TraceReader reader(input, true);
+		size_t n = 0;
+		while (const TraceEntry* batch = reader.next(n)) {
+			for (size_t j = 0; j < n; j++) {
+				if (batch[j].field >= Cores) {
+					cout << "Command Format error" << endl;
+					return 0;
+				}
+				checkAddressWidth(batch[j].address);
+				multiCore.access(batch[j].field, batch[j].address, batch[j].operation);
+			}
+			CACHE_PROFILE_RECORDS(n);
+		}
+		if (reader.bad()) {
+			cout << "Command Format error" << endl;
+			return 0;
+		}
+		multiCore.print_statistics();
+		return 0;
+	}
+	CacheSystem cacheSystem(cfg);
+	std::unique_ptr<IntervalWriter> intervals;
+	bool json = (IntervalFormat == "json");
+	if (Interval > 0) {
+		intervals.reset(new IntervalWriter(IntervalFile));
+		if (!intervals->good()) {
+			cerr << "File not found" << endl;
+			return 0;
+		}
+		if (!json) {
+			intervals->write(cacheSystem.intervalHeader());
+		}
+	}
+	unsigned long count = 0;
+	unsigned long lineNum = 0;
+	unsigned long skip = 0; // lines already simulated by the restored checkpoint
+	if (!RestoreFile.empty()) {
+		// checkpoint file: trace lines consumed, then the cache system state
+		FILE* in = fopen(RestoreFile.c_str(), "rb");
+		if (!in) {
+			cerr << "File not found" << endl;
+			return 0;
+		}
+		bool ok = fread(&lineNum, sizeof(lineNum), 1, in) == 1 && cacheSystem.loadCheckpoint(in);
+		fclose(in);
+		if (!ok) {
+			cerr << "Checkpoint does not match the configuration" << endl;
+			return 0;
+		}
+		skip = lineNum;
+		if (ResetStats) {
+			cacheSystem.resetStatistics();
+		}
+	}
+	TraceReader reader(input, Timestamps != 0);
+	size_t n = 0;
+	while (const TraceEntry* batch = reader.next(n)) {
+		for (size_t j = 0; j < n; j++) {
+			if (skip > 0) {
+				skip--;
+				continue;
+			}
+			unsigned long int num = batch[j].address;
+			checkAddressWidth(num);
+			cacheSystem.accessAt(num, batch[j].operation, Timestamps ? (double)batch[j].field : -1);
+			if (++lineNum == CheckpointAt && !CheckpointFile.empty()) {
+				FILE* out = fopen(CheckpointFile.c_str(), "wb");
+				if (!out || fwrite(&lineNum, sizeof(lineNum), 1, out) != 1 || !cacheSystem.saveCheckpoint(out)) {
+					cerr << "Cannot write checkpoint" << endl;
+				}
+				if (out) {
+					fclose(out);
+				}
+			}
+			if (Interval > 0 && ++count == Interval) {
+				intervals->write(cacheSystem.intervalRecord(json));
+				count = 0;
+			}
+		}
+		CACHE_PROFILE_RECORDS(n);
+	}
+	if (reader.bad()) {
+		// Operation appears in an Invalid format
+		cout << "Command Format error" << endl;
+		return 0;
+	}
+	if (Interval > 0 && count > 0) {
+		intervals->write(cacheSystem.intervalRecord(json)); // last partial interval
 	}
-	//double L1MissRate;
-	//double L2MissRate;
-	//double avgAccTime;
-	//printf("L1miss=%.03f ", L1MissRate);
-	//printf("L2miss=%.03f ", L2MissRate);
-	//printf("AccTimeAvg=%.03f\n", avgAccTime);
 	cacheSystem.print_statistics();
 	return 0;
 }
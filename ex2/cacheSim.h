@@ -0,0 +1,2541 @@
+// course - Computer Architecture 046267
+// hw-2 cache simulator - cache model library
+// Cache, CacheSystem and the other models used by cacheSim, for linking into other trace tools.
+// C callers use cache_api.h instead.
+/*------------------------------------------------*/
+#ifndef CACHE_SIM_H_
+#define CACHE_SIM_H_
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <list>
+#include <set>
+#include <memory>
+#include <stdint.h>
+
+#include "cache_api.h"
+
+// address width - -DCACHE_ADDR64 (make ADDR64=1) for 64 bit traces, the default build keeps
+// 32 bit addresses and tags so the blocks stay compact
+#ifdef CACHE_ADDR64
+#define ADDRESS_SIZE 64 //address is 64 bit long
+#define CHECKPOINT_MAGIC 0x43534437 // "CSD7" - the block layout differs from the 32 bit build
+typedef uint64_t address_t;
+#else
+#define ADDRESS_SIZE 32 //address is 32 bit long
+#define CHECKPOINT_MAGIC 0x43534450 // "CSDP" - CSCP checkpoints did not hold every counter
+typedef uint32_t address_t;
+#endif
+
+// sets with CACHE_INDEXED_WAYS ways or more get the O(1) lookup index (Cache::SetIndex),
+// make indexcheck builds a scan only copy and compares the two
+#ifndef CACHE_INDEXED_WAYS
+#define CACHE_INDEXED_WAYS 64
+#endif
+
+// self profiling - -DCACHE_PROFILE (make PROFILE=1) times the hot paths with scoped timers and
+// prints a per phase breakdown to stderr at exit, the default build compiles the scopes out.
+// a phase counts its own time, the scopes nested in it (a lookup inside a fill) go to theirs
+enum ProfilePhase {
+    PROF_DECODE = 0, // reading and parsing trace lines
+    PROF_LOOKUP = 1, // Cache::checkHit
+    PROF_REPLACE = 2, // victim choice and lru update
+    PROF_FILL = 3, // CacheSystem::fill - eviction, write back, inclusion
+    PROF_OUTPUT = 4, // statistics and interval records
+    PROF_PHASES = 5
+};
+#ifdef CACHE_PROFILE
+#include <chrono>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint64_t profileNow() {
+    return __rdtsc();
+}
+#else
+inline uint64_t profileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// totals of all threads, printed when the program exits - ticks are scaled to ns by the run's
+// wall clock
+class ProfileReport {
+private:
+    std::mutex lock;
+    uint64_t ticks[PROF_PHASES];
+    double calls[PROF_PHASES];
+    double records;
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point start;
+    ProfileReport() : records(0), startTicks(profileNow()), start(std::chrono::steady_clock::now()) {
+        std::fill(ticks, ticks + PROF_PHASES, 0);
+        std::fill(calls, calls + PROF_PHASES, 0);
+    }
+public:
+    static ProfileReport& get() {
+        static ProfileReport report;
+        return report;
+    }
+    void merge(const uint64_t* threadTicks, const double* threadCalls, double threadRecords) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (unsigned p = 0; p < PROF_PHASES; p++) {
+            ticks[p] += threadTicks[p];
+            calls[p] += threadCalls[p];
+        }
+        records += threadRecords;
+    }
+    ~ProfileReport() {
+        static const char* names[PROF_PHASES] = {"decode", "lookup", "replace", "fill", "output"};
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        uint64_t runTicks = profileNow() - startTicks;
+        double nsPerTick = runTicks ? ns / runTicks : 0;
+        fprintf(stderr, "profile records=%.0f wallNs=%.0f ns/record=%.03f\n", records, ns,
+                records ? ns / records : 0);
+        for (unsigned p = 0; p < PROF_PHASES; p++) {
+            double phaseNs = ticks[p] * nsPerTick;
+            fprintf(stderr, "profile phase=%s calls=%.0f ns=%.0f ns/record=%.03f ns/call=%.03f\n", names[p],
+                    calls[p], phaseNs, records ? phaseNs / records : 0, calls[p] ? phaseNs / calls[p] : 0);
+        }
+    }
+};
+
+// counters of one thread, merged into the report when the thread ends
+class ProfileCounters {
+private:
+    ProfileCounters() : records(0), nested(0) {
+        std::fill(ticks, ticks + PROF_PHASES, 0);
+        std::fill(calls, calls + PROF_PHASES, 0);
+        ProfileReport::get(); // the report must outlive every thread's counters
+    }
+public:
+    uint64_t ticks[PROF_PHASES];
+    double calls[PROF_PHASES];
+    double records; // trace records simulated
+    uint64_t nested; // ticks of the scopes nested in the open one
+
+    static ProfileCounters& get() {
+        static thread_local ProfileCounters counters;
+        return counters;
+    }
+    ~ProfileCounters() {
+        ProfileReport::get().merge(ticks, calls, records);
+    }
+};
+
+class ProfileScope {
+private:
+    ProfileCounters& counters;
+    ProfilePhase phase;
+    uint64_t outerNested;
+    uint64_t start;
+public:
+    ProfileScope(ProfilePhase phase)
+        : counters(ProfileCounters::get()), phase(phase), outerNested(counters.nested), start(profileNow()) {
+        counters.nested = 0;
+    }
+    ~ProfileScope() {
+        uint64_t elapsed = profileNow() - start;
+        counters.ticks[phase] += elapsed - counters.nested;
+        counters.calls[phase]++;
+        counters.nested = outerNested + elapsed;
+    }
+};
+#define CACHE_PROFILE_SCOPE(phase) ProfileScope profileScope(phase)
+#define CACHE_PROFILE_RECORDS(n) (ProfileCounters::get().records += (n))
+#else
+#define CACHE_PROFILE_SCOPE(phase)
+#define CACHE_PROFILE_RECORDS(n)
+#endif
+/*--------------------------------------------------------------------------------------------------------*/
+ //define struct cache block
+struct cacheBlock {
+    address_t tag = 0; // tag
+    bool valid = 0; // valid bit
+    bool dirty = 0; // dirty bit 
+    bool shared = 0; // mesi S state (multi core) - valid clean not shared is E, dirty is M
+    bool prefetched = 0; // filled by a prefetch and not demanded yet
+    unsigned evictCount = 0; // evicted counter lru
+};
+
+// set index functions
+enum IndexFunction {
+    INDEX_BITS = 0, // plain address bits
+    INDEX_XOR = 1, // tag bits xor folded into the index
+    INDEX_PRIME = 2, // block number modulo the largest prime <= number of sets
+    INDEX_SKEW = 3 // skewed associative - a different xor hash per way
+};
+
+// inclusion policy of a level towards the levels above it
+enum InclusionPolicy {
+    INCL_NINE = 0, // neither inclusive nor exclusive - evictions leave the levels above alone
+    INCL_INCLUSIVE = 1, // evictions back-invalidate the levels above
+    INCL_EXCLUSIVE = 2 // holds the victims of the level above, a hit moves the block up
+};
+
+// class cache level 
+class Cache {
+private:
+    unsigned cacheSize; // size
+    unsigned blockSize, assoc; // block size ans assoc
+    unsigned accessTime; // access time 
+    unsigned num_of_sets; //number of sets
+    unsigned num_of_ways; //number of ways
+    unsigned set_size; // set size in bits
+    unsigned offset_size; //offset size in bits
+    unsigned tag_size; // tag size in bits
+    std::vector<std::vector<cacheBlock>> blocks; // vector of vector of blocks
+    unsigned indexFn; // IndexFunction
+    unsigned prime; // sets used by INDEX_PRIME
+    unsigned lruClock; // INDEX_SKEW keeps lru time stamps in evictCount (the set differs per way)
+
+    // renumber the skewed time stamps 1..n in their order before lruClock wraps - only the order
+    // between blocks is ever compared, so every later victim stays the same
+    void renormalizeClock() {
+        std::vector<cacheBlock*> stamped;
+        for (unsigned i = 0; i < num_of_sets; i++) {
+            for (unsigned w = 0; w < num_of_ways; w++) {
+                if (blocks[i][w].evictCount) {
+                    stamped.push_back(&blocks[i][w]);
+                }
+            }
+        }
+        std::sort(stamped.begin(), stamped.end(), [](const cacheBlock* a, const cacheBlock* b) {
+            return a->evictCount < b->evictCount;
+        });
+        lruClock = 0;
+        for (unsigned j = 0; j < stamped.size(); j++) {
+            stamped[j]->evictCount = ++lruClock;
+        }
+    }
+
+    // lookup index of sets with INDEXED_WAYS ways or more - an open addressing tag hash and an lru
+    // list per set make lookup, victim choice and lru update O(1) instead of a scan of the ways.
+    // victims match the scan: the lowest invalid way, else the least recently used one
+    struct SetIndex {
+        std::vector<unsigned> slots; // way + 1 of every valid block, 0 = empty, linear probing
+        std::vector<unsigned> prev, next; // lru list, node num_of_ways is the head (mru side)
+        std::set<unsigned> freeWays; // invalid ways
+    };
+    std::vector<SetIndex> setIndex; // empty - plain scan (low associativity or skewed)
+    unsigned slotMask;
+
+    // hash of the tag used by way w in skewed mode (way 0 is the plain xor fold)
+    unsigned skewHash(address_t tag, unsigned way) const {
+        address_t h = tag * (2 * way + 1);
+        return (h ^ (h >> 7) ^ (way ? h >> 13 : 0)) & ((1 << set_size) - 1);
+    }
+    unsigned slotOf(address_t tag) const {
+        uint64_t h = (uint64_t)tag * 0x9E3779B97F4A7C15ULL; // fibonacci hashing
+        return (unsigned)(h >> 32) & slotMask;
+    }
+    void indexInsert(unsigned index, unsigned way) {
+        std::vector<unsigned>& slots = setIndex[index].slots;
+        unsigned i = slotOf(blocks[index][way].tag);
+        while (slots[i] != 0) {
+            i = (i + 1) & slotMask;
+        }
+        slots[i] = way + 1;
+        setIndex[index].freeWays.erase(way);
+    }
+    // drop a valid way from the hash - backward shift, so no tombstones build up
+    void indexErase(unsigned index, unsigned way) {
+        std::vector<unsigned>& slots = setIndex[index].slots;
+        unsigned i = slotOf(blocks[index][way].tag);
+        while (slots[i] != way + 1) {
+            i = (i + 1) & slotMask;
+        }
+        slots[i] = 0;
+        for (unsigned j = (i + 1) & slotMask; slots[j] != 0; j = (j + 1) & slotMask) {
+            unsigned home = slotOf(blocks[index][slots[j] - 1].tag);
+            // the entry stays when its home lies cyclically in (i, j]
+            if ((i < j) ? (home <= i || home > j) : (home <= i && home > j)) {
+                slots[i] = slots[j];
+                slots[j] = 0;
+                i = j;
+            }
+        }
+        setIndex[index].freeWays.insert(way);
+    }
+    // move way to the mru end of the list (ways never touched are self linked)
+    void indexTouch(unsigned index, unsigned way) {
+        SetIndex& set = setIndex[index];
+        unsigned head = num_of_ways;
+        if (set.next[way] != way) {
+            set.next[set.prev[way]] = set.next[way];
+            set.prev[set.next[way]] = set.prev[way];
+        }
+        set.next[way] = set.next[head];
+        set.prev[way] = head;
+        set.prev[set.next[head]] = way;
+        set.next[head] = way;
+    }
+    void indexReset(unsigned index) {
+        SetIndex& set = setIndex[index];
+        set.slots.assign(slotMask + 1, 0);
+        set.prev.resize(num_of_ways + 1);
+        set.next.resize(num_of_ways + 1);
+        for (unsigned w = 0; w <= num_of_ways; w++) {
+            set.prev[w] = set.next[w] = w;
+        }
+        set.freeWays.clear();
+        for (unsigned w = 0; w < num_of_ways; w++) {
+            set.freeWays.insert(w);
+        }
+    }
+    address_t tagOf(address_t address) const {
+        if (indexFn == INDEX_PRIME) {
+            return (address >> offset_size) / prime;
+        }
+        return address >> (offset_size + set_size);
+    }
+
+public:
+    static const unsigned INDEXED_WAYS = CACHE_INDEXED_WAYS; // ways from which a set gets the lookup index
+
+// consrtuctor
+    Cache(unsigned cacheSize, unsigned blockSize, unsigned assoc, unsigned accessTime, unsigned indexFn = INDEX_BITS)
+        : cacheSize(cacheSize), blockSize(blockSize), assoc(assoc), accessTime(accessTime), indexFn(indexFn), lruClock(0) {
+        set_size = cacheSize - blockSize - assoc; // calc of set size - can be shown log2 of num of sets
+        num_of_sets = 1 << set_size; // pow2
+        num_of_ways = 1 << assoc; // pow2
+        offset_size = blockSize; // in bits- log2(bytes)
+        tag_size = ADDRESS_SIZE - offset_size - set_size; // calc    
+        blocks.resize(num_of_sets, std::vector<cacheBlock>(num_of_ways)); //resize vector of vectors
+        prime = num_of_sets;
+        if (indexFn == INDEX_PRIME) {
+            // largest prime <= number of sets (1 set stays 1)
+            for (prime = num_of_sets; prime > 2; prime--) {
+                bool isPrime = true;
+                for (unsigned d = 2; d * d <= prime && isPrime; d++) {
+                    isPrime = (prime % d != 0);
+                }
+                if (isPrime) {
+                    break;
+                }
+            }
+        }
+        slotMask = 0;
+        if (num_of_ways >= INDEXED_WAYS && indexFn != INDEX_SKEW) {
+            slotMask = 2 * num_of_ways - 1; // load factor <= 1/2
+            setIndex.resize(num_of_sets);
+            for (unsigned i = 0; i < num_of_sets; i++) {
+                indexReset(i);
+            }
+        }
+    }
+
+    // Check for hit
+    bool checkHit(address_t address, unsigned& way_index) {
+        CACHE_PROFILE_SCOPE(PROF_LOOKUP);
+        address_t tag = tagOf(address); // calc tag
+        if (indexFn == INDEX_SKEW) {
+            for (unsigned i = 0; i < num_of_ways; i++) {
+                cacheBlock& block = blocks[getIndex(address, i)][i];
+                if (block.valid && block.tag == tag) {
+                    way_index = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        unsigned index = getIndex(address); // calc index
+        if (!setIndex.empty()) {
+            const std::vector<unsigned>& slots = setIndex[index].slots;
+            for (unsigned i = slotOf(tag); slots[i] != 0; i = (i + 1) & slotMask) {
+                if (blocks[index][slots[i] - 1].tag == tag) {
+                    way_index = slots[i] - 1;
+                    return true;
+                }
+            }
+            return false;
+        }
+         // look for hit    
+        for (unsigned i = 0; i < num_of_ways; i++) {
+            if (blocks[index][i].valid && blocks[index][i].tag == tag) {
+                way_index = i;
+                return true;
+            }
+        }
+        return false;
+    }
+    // pick the way to fill address into - an invalid way if there is one (returns true), else lru
+    bool findVictim(address_t address, unsigned& way_index) {
+        CACHE_PROFILE_SCOPE(PROF_REPLACE);
+        if (indexFn != INDEX_SKEW) {
+            unsigned index = getIndex(address);
+            if (!setIndex.empty()) {
+                const SetIndex& set = setIndex[index];
+                if (!set.freeWays.empty()) {
+                    way_index = *set.freeWays.begin();
+                    return true;
+                }
+                way_index = set.prev[num_of_ways]; // lru end
+                return false;
+            }
+            if (findInvalidWay(index, way_index)) {
+                return true;
+            }
+            findByEvictedCount(index, way_index);
+            return false;
+        }
+        // skewed - every way offers a different set, oldest time stamp loses
+        way_index = 0;
+        for (unsigned i = 0; i < num_of_ways; i++) {
+            const cacheBlock& block = blocks[getIndex(address, i)][i];
+            if (!block.valid) {
+                way_index = i;
+                return true;
+            }
+            if (block.evictCount < blocks[getIndex(address, way_index)][way_index].evictCount) {
+                way_index = i;
+            }
+        }
+        return false;
+    }
+    // Find invalid way- empty block
+    bool findInvalidWay(unsigned index, unsigned& way_index) {
+        for (unsigned i = 0; i < num_of_ways; i++) {
+            if (!blocks[index][i].valid) {
+                way_index = i;
+                return true;
+            }
+        }
+        return false;
+    }
+    // find oldest - by lru alg
+    void findByEvictedCount(unsigned index, unsigned& way_index) {
+        for (unsigned i = 0; i < num_of_ways; i++) {
+            if (blocks[index][i].evictCount == 0) {
+                way_index = i;
+                break;
+            }
+        }
+        return;
+    }
+
+    // Update evicted counter
+    void updateLRU(unsigned index, unsigned way_index) {
+        CACHE_PROFILE_SCOPE(PROF_REPLACE);
+        if (indexFn == INDEX_SKEW) {
+            if (lruClock == UINT_MAX) {
+                renormalizeClock();
+            }
+            blocks[index][way_index].evictCount = ++lruClock;
+            return;
+        }
+        if (!setIndex.empty()) {
+            indexTouch(index, way_index);
+            return;
+        }
+        unsigned x = blocks[index][way_index].evictCount;
+        blocks[index][way_index].evictCount = num_of_ways - 1; 
+        for (unsigned j = 0; j < num_of_ways; j++) {
+            if (j != way_index && blocks[index][j].evictCount > x) {
+                blocks[index][j].evictCount--;
+            }
+        }
+        return;
+    }
+
+    // Insert block into cache
+    void insertBlock(address_t address, unsigned way, bool isDirty) {
+        unsigned index = getIndex(address, way);
+        address_t tag = tagOf(address);
+        if (!setIndex.empty() && blocks[index][way].valid) {
+            indexErase(index, way); // the lru victim is replaced
+        }
+        blocks[index][way].valid = true;
+        blocks[index][way].tag = tag;
+        blocks[index][way].dirty = isDirty;
+        blocks[index][way].shared = false;
+        blocks[index][way].prefetched = false;
+        if (!setIndex.empty()) {
+            indexInsert(index, way);
+        }
+    }
+
+    // Invalidate block
+    bool invalidate(address_t address) {
+        unsigned i;
+        if (checkHit(address, i)) {
+            unsigned index = getIndex(address, i);
+            bool wasDirty = blocks[index][i].dirty;
+            if (!setIndex.empty()) {
+                indexErase(index, i);
+            }
+            blocks[index][i].valid = false;
+            blocks[index][i].dirty = false;
+            blocks[index][i].shared = false;
+            return wasDirty;
+        }
+        return false;
+    }
+
+    // Get block address - inverse of the index function
+    address_t getBlockAddress(unsigned index, unsigned way_index) const {
+        address_t tag = blocks[index][way_index].tag;
+        address_t mask = (1 << set_size) - 1;
+        switch (indexFn) {
+        case INDEX_XOR:
+            return (tag << (set_size + offset_size)) | ((index ^ (tag & mask)) << offset_size);
+        case INDEX_PRIME:
+            return (tag * prime + index) << offset_size;
+        case INDEX_SKEW:
+            return (tag << (set_size + offset_size)) | ((index ^ skewHash(tag, way_index)) << offset_size);
+        default:
+            return (tag << (set_size + offset_size)) | (index << offset_size);
+        }
+    }
+
+    // Check dirty
+    bool isDirty(unsigned index, unsigned way_index) {
+        return blocks[index][way_index].dirty;
+    }
+
+    // Set dirty 
+    void setDirty(unsigned index, unsigned way_index) {
+        blocks[index][way_index].dirty = true;
+    }
+    // Clear dirty - block was flushed below
+    void clearDirty(unsigned index, unsigned way_index) {
+        blocks[index][way_index].dirty = false;
+    }
+
+    // Check / set mesi shared state
+    bool isShared(unsigned index, unsigned way_index) {
+        return blocks[index][way_index].shared;
+    }
+    void setShared(unsigned index, unsigned way_index, bool shared) {
+        blocks[index][way_index].shared = shared;
+    }
+
+    // Check / set prefetched - cleared by the first demand hit
+    bool isPrefetched(unsigned index, unsigned way_index) {
+        return blocks[index][way_index].prefetched;
+    }
+    void setPrefetched(unsigned index, unsigned way_index, bool prefetched) {
+        blocks[index][way_index].prefetched = prefetched;
+    }
+    // get access time 
+    unsigned getAccessTime() const { 
+        return accessTime; 
+    }
+    // number of set index bits
+    unsigned getSetBits() const {
+        return set_size;
+    }
+    // number of ways
+    unsigned getWays() const {
+        return num_of_ways;
+    }
+    // get index of address
+    unsigned getIndex(address_t address) {
+        return getIndex(address, 0);
+    }
+    // get index of address in a way (only skewed mode depends on the way)
+    unsigned getIndex(address_t address, unsigned way_index) {
+        address_t mask = (1 << set_size) - 1;
+        address_t block = address >> offset_size;
+        switch (indexFn) {
+        case INDEX_XOR:
+            return (block ^ (block >> set_size)) & mask;
+        case INDEX_PRIME:
+            return block % prime;
+        case INDEX_SKEW:
+            return ((block & mask) ^ skewHash(block >> set_size, way_index)) & mask;
+        default:
+            return block & mask;
+        }
+    }
+
+    // Check if block is valid
+    bool isValid(unsigned index, unsigned way_index) const {
+        return blocks[index][way_index].valid;
+    }
+
+    // write geometry and every block to a checkpoint file
+    bool save(FILE* out) const {
+        unsigned geometry[5] = {num_of_sets, num_of_ways, offset_size, indexFn, prime};
+        if (fwrite(geometry, sizeof(geometry), 1, out) != 1) {
+            return false;
+        }
+        for (unsigned i = 0; i < num_of_sets; i++) {
+            std::vector<cacheBlock> set(blocks[i]);
+            if (!setIndex.empty()) {
+                // indexed sets keep the lru order in the list - store it as the scan's ranks
+                unsigned rank = num_of_ways;
+                for (unsigned w = setIndex[i].next[num_of_ways]; w != num_of_ways; w = setIndex[i].next[w]) {
+                    set[w].evictCount = --rank;
+                }
+            }
+            if (fwrite(set.data(), sizeof(cacheBlock), num_of_ways, out) != num_of_ways) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // read blocks back, false if the checkpoint has another geometry
+    bool load(FILE* in) {
+        unsigned geometry[5];
+        if (fread(geometry, sizeof(geometry), 1, in) != 1 || geometry[0] != num_of_sets ||
+            geometry[1] != num_of_ways || geometry[2] != offset_size || geometry[3] != indexFn ||
+            geometry[4] != prime) {
+            return false;
+        }
+        lruClock = 0;
+        for (unsigned i = 0; i < num_of_sets; i++) {
+            if (fread(blocks[i].data(), sizeof(cacheBlock), num_of_ways, in) != num_of_ways) {
+                return false;
+            }
+            if (indexFn == INDEX_SKEW) {
+                for (unsigned w = 0; w < num_of_ways; w++) {
+                    lruClock = std::max(lruClock, blocks[i][w].evictCount); // stamps continue after the newest
+                }
+            }
+            if (!setIndex.empty()) {
+                indexReset(i);
+                std::vector<unsigned> order(num_of_ways);
+                for (unsigned w = 0; w < num_of_ways; w++) {
+                    order[w] = w;
+                    if (blocks[i][w].valid) {
+                        indexInsert(i, w);
+                    }
+                }
+                std::stable_sort(order.begin(), order.end(), [this, i](unsigned a, unsigned b) {
+                    return blocks[i][a].evictCount < blocks[i][b].evictCount;
+                });
+                for (unsigned w = 0; w < num_of_ways; w++) {
+                    indexTouch(i, order[w]); // lowest rank first, the highest ends up mru
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// printf appended to a string - statistics fields grow with the counts, so no fixed buffer
+inline void appendf(std::string& out, const char* format, ...) {
+    va_list args, again;
+    va_start(args, format);
+    va_copy(again, args);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length > 0) {
+        size_t at = out.size();
+        out.resize(at + length + 1);
+        vsnprintf(&out[at], length + 1, format, again);
+        out.resize(at + length);
+    }
+    va_end(again);
+}
+
+// checkpoint helpers for counter vectors
+inline bool saveCounters(FILE* out, const std::vector<double>& v) {
+    unsigned n = v.size();
+    return fwrite(&n, sizeof(n), 1, out) == 1 && fwrite(v.data(), sizeof(double), n, out) == n;
+}
+inline bool loadCounters(FILE* in, std::vector<double>& v) {
+    unsigned n;
+    return fread(&n, sizeof(n), 1, in) == 1 && n == v.size() && fread(v.data(), sizeof(double), n, in) == n;
+}
+// containers of plain items - block number sets and lists (three c first touch, prefetch
+// victims), queues of pending requests and predictor tables
+template <class Items>
+inline bool saveItems(FILE* out, const Items& items) {
+    std::vector<typename Items::value_type> v(items.begin(), items.end());
+    unsigned n = v.size();
+    return fwrite(&n, sizeof(n), 1, out) == 1 && fwrite(v.data(), sizeof(v[0]), n, out) == n;
+}
+template <class Items>
+inline bool loadItems(FILE* in, Items& items) {
+    unsigned n;
+    if (fread(&n, sizeof(n), 1, in) != 1) {
+        return false;
+    }
+    std::vector<typename Items::value_type> v(n);
+    if (fread(v.data(), sizeof(v[0]), n, in) != n) {
+        return false;
+    }
+    items = Items(v.begin(), v.end());
+    return true;
+}
+// per level parameters, sizes in log2 like the flags
+struct LevelConfig {
+    unsigned Size = 0, Assoc = 0, Cyc = 0;
+    int WrAlloc = -1; // -1 = use --wr-alloc
+    int Inclusive = -1; // InclusionPolicy, -1 = use --inclusion
+    std::string Prefetch = "none"; // none, next, stride, delta
+    unsigned Index = INDEX_BITS; // set index function
+    unsigned Mshr = 8; // miss status holding registers (timing mode), 0 = unlimited
+};
+
+// cache system parameters as given on the command line (or config file)
+struct SimConfig {
+    unsigned MemCyc = 0, BSize = 0, WrAlloc = 0;
+    unsigned PfDegree = 1, PfQueue = 16, PfLatency = 0; // latency in demand accesses
+    unsigned VcEntries = 0, VcCyc = 0; // victim cache between L1 and L2, 0 entries = none
+    unsigned WbEntries = 0, WbCyc = 0; // write buffer between L1 and L2, WbCyc to drain one entry
+    unsigned ThreeC = 0; // classify misses as compulsory / capacity / conflict
+    unsigned SampleRatio = 1; // simulate about 1/SampleRatio of the sets
+    int Inclusion = -1; // InclusionPolicy of the levels below L1, -1 = inclusive without the statistics
+    unsigned Timing = 0, IssueRate = 1; // non-blocking timing model, cycles between issues
+    unsigned Traffic = 0; // print writebacks and memory traffic
+    unsigned L1ISize = 0, L1IAssoc = 0, L1ICyc = 0; // instruction cache next to L1, 0 size = none
+    double MemBandwidth = 0; // bytes per cycle of the fixed latency memory, 0 = unlimited
+    // dram backend instead of the fixed MemCyc, row size in log2 bytes, timings in cycles
+    unsigned Dram = 0, DramChannels = 1, DramBanks = 8, DramRow = 11;
+    unsigned DramTRCD = 14, DramTCAS = 14, DramTRP = 14, DramTBurst = 4;
+    std::string DramPage = "open"; // open / closed
+    std::string DramMap = "row"; // row - consecutive blocks share a row, block - spread over banks
+    std::vector<LevelConfig> levels = std::vector<LevelConfig>(2); // L1, L2 by default
+};
+
+// inclusion policy of level k after the per level and global flags
+inline unsigned levelInclusion(const SimConfig& cfg, unsigned k) {
+    if (cfg.levels[k].Inclusive >= 0) {
+        return cfg.levels[k].Inclusive;
+    }
+    return k > 0 && cfg.Inclusion >= 0 ? cfg.Inclusion : INCL_INCLUSIVE;
+}
+
+// parse one cache system flag, false if the flag is not a cache system flag
+// level flags are --l<k>-size/assoc/cyc/wr-alloc/incl/index/mshr/pf, a higher k adds levels
+bool parseSimOption(const std::string& s, const char* value, SimConfig& cfg);
+// check the flag combination once every flag is parsed, false if the cache system cannot model it
+bool checkSimConfig(const SimConfig& cfg);
+// the multi core model only has private L1s and shared inclusive / nine levels - false if the
+// config asks for anything it would silently leave out
+bool checkMultiCoreConfig(const SimConfig& cfg);
+
+// parse one trace line "<op> 0x<address>", false on a malformed line
+bool parseTraceLine(const std::string& line, char& operation, unsigned long& num);
+// trace line with a third field "<op> 0x<address> <field>" - the core id (multi core) or the
+// issue cycle (timing mode), a missing field reads as 0
+bool parseTraceLine(const std::string& line, char& operation, unsigned long& num, unsigned long& field);
+
+// prefetcher interface - trained with the block number of every demand access reaching its level
+class Prefetcher {
+public:
+    virtual ~Prefetcher() {}
+    // hit - the demand hit this level, out - block numbers to prefetch
+    virtual void train(address_t block, bool hit, std::vector<address_t>& out) = 0;
+    // checkpoint - the training state, a stateless prefetcher has nothing to keep
+    virtual bool save(FILE* out) const {
+        (void)out;
+        return true;
+    }
+    virtual bool load(FILE* in) {
+        (void)in;
+        return true;
+    }
+};
+
+// next line - on a miss fetch the next degree blocks
+class NextLinePrefetcher : public Prefetcher {
+private:
+    unsigned degree;
+public:
+    NextLinePrefetcher(unsigned degree) : degree(degree) {}
+    void train(address_t block, bool hit, std::vector<address_t>& out) {
+        if (hit) {
+            return;
+        }
+        for (unsigned i = 1; i <= degree; i++) {
+            out.push_back(block + i);
+        }
+    }
+};
+
+// pc-less stream detector - streams are matched by nearby block numbers and
+// prefetch ahead once the same stride was seen twice in a row
+class StridePrefetcher : public Prefetcher {
+private:
+    struct Stream {
+        address_t last = 0;
+        int stride = 0;
+        unsigned confidence = 0;
+        unsigned lru = 0;
+        bool valid = false;
+    };
+    static const unsigned NUM_STREAMS = 16;
+    static const int WINDOW = 16; // blocks
+    unsigned degree;
+    unsigned now;
+    std::vector<Stream> streams;
+public:
+    StridePrefetcher(unsigned degree) : degree(degree), now(0), streams(NUM_STREAMS) {}
+    // trained on hits too - a stream whose prefetches hit has to keep running ahead
+    void train(address_t block, bool /*hit*/, std::vector<address_t>& out) {
+        now++;
+        Stream* match = NULL;
+        Stream* victim = &streams[0];
+        for (unsigned i = 0; i < streams.size(); i++) {
+            Stream& st = streams[i];
+            int delta = (int)(block - st.last);
+            if (st.valid && delta != 0 && delta >= -WINDOW && delta <= WINDOW) {
+                match = &st;
+                break;
+            }
+            if (!st.valid || st.lru < victim->lru) {
+                victim = &st;
+            }
+        }
+        if (!match) {
+            victim->valid = true;
+            victim->last = block;
+            victim->stride = 0;
+            victim->confidence = 0;
+            victim->lru = now;
+            return;
+        }
+        int delta = (int)(block - match->last);
+        if (delta == match->stride) {
+            match->confidence++;
+        } else {
+            match->stride = delta;
+            match->confidence = 0;
+        }
+        match->last = block;
+        match->lru = now;
+        if (match->confidence >= 1) {
+            for (unsigned i = 1; i <= degree; i++) {
+                out.push_back(block + match->stride * (int)i);
+            }
+        }
+    }
+    bool save(FILE* out) const {
+        return fwrite(&now, sizeof(now), 1, out) == 1 && saveItems(out, streams);
+    }
+    bool load(FILE* in) {
+        return fread(&now, sizeof(now), 1, in) == 1 && loadItems(in, streams) && streams.size() == NUM_STREAMS;
+    }
+};
+
+// delta correlation - keeps the recent miss deltas, finds the last occurrence of the
+// newest delta pair and replays the deltas that followed it
+class DeltaPrefetcher : public Prefetcher {
+private:
+    static const unsigned HISTORY = 16;
+    unsigned degree;
+    address_t last;
+    bool haveLast;
+    std::deque<int> deltas;
+public:
+    DeltaPrefetcher(unsigned degree) : degree(degree), last(0), haveLast(false) {}
+    void train(address_t block, bool hit, std::vector<address_t>& out) {
+        if (hit) {
+            return;
+        }
+        if (haveLast) {
+            deltas.push_back((int)(block - last));
+            if (deltas.size() > HISTORY) {
+                deltas.pop_front();
+            }
+        }
+        last = block;
+        haveLast = true;
+        unsigned n = deltas.size();
+        if (n < 3) {
+            return;
+        }
+        for (unsigned i = n - 2; i-- > 1;) {
+            if (deltas[i - 1] == deltas[n - 2] && deltas[i] == deltas[n - 1]) {
+                address_t addr = block;
+                for (unsigned j = i + 1; j < n && out.size() < degree; j++) {
+                    addr += deltas[j];
+                    out.push_back(addr);
+                }
+                return;
+            }
+        }
+    }
+    bool save(FILE* out) const {
+        return fwrite(&last, sizeof(last), 1, out) == 1 && fwrite(&haveLast, sizeof(haveLast), 1, out) == 1 &&
+               saveItems(out, deltas);
+    }
+    bool load(FILE* in) {
+        return fread(&last, sizeof(last), 1, in) == 1 && fread(&haveLast, sizeof(haveLast), 1, in) == 1 &&
+               loadItems(in, deltas);
+    }
+};
+
+// prefetcher by name (none, next, stride, delta), NULL for none
+Prefetcher* makePrefetcher(const std::string& kind, unsigned degree);
+
+// fully associative lru shadow of a cache level (three c classification)
+// list + hash map so every access is O(1) regardless of the capacity
+class ShadowCache {
+private:
+    unsigned capacity; // blocks
+    std::list<address_t> lru; // front is mru
+    std::unordered_map<address_t, std::list<address_t>::iterator> where;
+public:
+    ShadowCache(unsigned capacity) : capacity(capacity) {}
+    // returns hit, allocate=false leaves a missing block out
+    bool access(address_t block, bool allocate) {
+        std::unordered_map<address_t, std::list<address_t>::iterator>::iterator it = where.find(block);
+        if (it != where.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return true;
+        }
+        if (allocate) {
+            if (lru.size() >= capacity) {
+                where.erase(lru.back());
+                lru.pop_back();
+            }
+            lru.push_front(block);
+            where[block] = lru.begin();
+        }
+        return false;
+    }
+    // checkpoint - the blocks from mru to lru
+    bool save(FILE* out) const {
+        std::vector<address_t> v(lru.begin(), lru.end());
+        unsigned n = v.size();
+        return fwrite(&n, sizeof(n), 1, out) == 1 && fwrite(v.data(), sizeof(address_t), n, out) == n;
+    }
+    bool load(FILE* in) {
+        unsigned n;
+        if (fread(&n, sizeof(n), 1, in) != 1 || n > capacity) {
+            return false;
+        }
+        std::vector<address_t> v(n);
+        if (fread(v.data(), sizeof(address_t), n, in) != n) {
+            return false;
+        }
+        lru.assign(v.begin(), v.end());
+        where.clear();
+        for (std::list<address_t>::iterator it = lru.begin(); it != lru.end(); ++it) {
+            where[*it] = it;
+        }
+        return true;
+    }
+};
+
+// dram behind the last cache level - channels of banks with one row buffer each
+// a request waits for its bank, then pays tCAS on a row hit, tRCD + tCAS on a closed bank
+// and tRP + tRCD + tCAS on a row conflict, the data burst holds the channel bus
+class DramModel {
+private:
+    struct Bank {
+        bool open;
+        address_t row;
+        double readyAt;
+    };
+    unsigned channels, banks, rowBlocks, blockBits;
+    unsigned tRCD, tCAS, tRP, tBurst;
+    bool closedPage, blockMap;
+    std::vector<Bank> bankState; // channel * banks + bank
+    std::vector<double> busFree; // per channel
+public:
+    double reads, writes, rowHits, rowEmpty, rowConflicts, readLatency;
+
+    DramModel(const SimConfig& cfg)
+        : channels(std::max(cfg.DramChannels, 1u)),
+          banks(std::max(cfg.DramBanks, 1u)),
+          rowBlocks(cfg.DramRow > cfg.BSize ? 1u << (cfg.DramRow - cfg.BSize) : 1),
+          blockBits(cfg.BSize),
+          tRCD(cfg.DramTRCD), tCAS(cfg.DramTCAS), tRP(cfg.DramTRP), tBurst(cfg.DramTBurst),
+          closedPage(cfg.DramPage == "closed"),
+          blockMap(cfg.DramMap == "block"),
+          busFree(channels, 0),
+          reads(0), writes(0), rowHits(0), rowEmpty(0), rowConflicts(0), readLatency(0) {
+        Bank idle = {false, 0, 0};
+        bankState.assign(channels * banks, idle);
+    }
+    // request for the block of address at cycle now, returns the cycles until the data is done
+    double access(address_t address, double now, bool write) {
+        address_t block = address >> blockBits;
+        unsigned channel, bank;
+        address_t row;
+        if (blockMap) {
+            // row:column:bank:channel
+            channel = block % channels;
+            block /= channels;
+            bank = block % banks;
+            row = block / banks / rowBlocks;
+        } else {
+            // row:bank:channel:column
+            block /= rowBlocks;
+            channel = block % channels;
+            block /= channels;
+            bank = block % banks;
+            row = block / banks;
+        }
+        Bank& b = bankState[channel * banks + bank];
+        double start = std::max(now, b.readyAt);
+        double lat = tCAS;
+        if (b.open && b.row == row) {
+            rowHits++;
+        } else if (!b.open) {
+            rowEmpty++;
+            lat += tRCD;
+        } else {
+            rowConflicts++;
+            lat += tRP + tRCD;
+        }
+        double done = std::max(start + lat, busFree[channel]) + tBurst;
+        busFree[channel] = done;
+        b.open = !closedPage;
+        b.row = row;
+        b.readyAt = closedPage ? done + tRP : done; // closed page precharges right away
+        if (write) {
+            writes++;
+        } else {
+            reads++;
+            readLatency += done - now;
+        }
+        return done - now;
+    }
+    // move the time origin, used when the clock of the caller restarts
+    void rebase(double offset) {
+        for (unsigned i = 0; i < bankState.size(); i++) {
+            bankState[i].readyAt = std::max(bankState[i].readyAt - offset, 0.0);
+        }
+        for (unsigned c = 0; c < channels; c++) {
+            busFree[c] = std::max(busFree[c] - offset, 0.0);
+        }
+    }
+    void resetStatistics() {
+        reads = writes = rowHits = rowEmpty = rowConflicts = readLatency = 0;
+    }
+    // checkpoint - open rows and bank / bus clocks, the counters are kept by the cache system
+    bool save(FILE* out) const {
+        return saveItems(out, bankState) && saveItems(out, busFree);
+    }
+    bool load(FILE* in) {
+        return loadItems(in, bankState) && bankState.size() == channels * banks && loadItems(in, busFree) &&
+               busFree.size() == channels;
+    }
+};
+
+// aggregated statistics returned by the batched access (cumulative since construction)
+struct CacheStats {
+    unsigned levels;
+    double accesses[CACHE_MAX_LEVELS];
+    double misses[CACHE_MAX_LEVELS];
+    double writebacks[CACHE_MAX_LEVELS];
+    double totalTime;
+};
+
+// decoded trace record - input of the batched access (and the sweep workers)
+struct TraceRecord {
+    unsigned long address;
+    char operation;
+};
+
+// calss cachesystem - chain of cache levels, levels[0] is L1, memory after the last one
+class CacheSystem {
+private:
+    unsigned memCycle;
+    std::vector<Cache> levels;
+    std::vector<unsigned> wrAlloc; // per level write allocate
+    std::vector<unsigned> inclusive; // per level InclusionPolicy
+    bool showInclusion; // the policy was given on the command line
+    double backInvalidations; // blocks above dropped by inclusive evictions
+    double totalTime;
+    std::vector<double> misses;
+    std::vector<double> accesses;
+    std::vector<double> levelTime; // cycles spent in each level (memory in the last slot)
+    std::vector<double> writebacks; // dirty blocks leaving each level
+    // previous interval snapshot
+    std::vector<double> lastAccesses, lastMisses, lastWritebacks, lastLevelTime;
+    double lastTotalTime;
+    unsigned long intervals;
+    // prefetching, per level
+    struct PendingPrefetch {
+        address_t address;
+        double readyAt; // demand access count at which the fill lands
+    };
+    struct PrefetchStats {
+        double issued = 0, useful = 0, late = 0, polluting = 0;
+    };
+    std::vector<std::unique_ptr<Prefetcher> > prefetchers;
+    std::vector<std::deque<PendingPrefetch> > pfQueue;
+    // blocks evicted by prefetch fills, oldest first - past a level's block count the oldest
+    // would be gone anyway. pfVictimAt finds a block's list entry, the two always change together
+    std::vector<std::list<address_t> > pfVictims;
+    std::vector<std::unordered_map<address_t, std::list<address_t>::iterator> > pfVictimAt;
+    std::vector<PrefetchStats> pfStats;
+    unsigned pfQueueSize, pfLatency, blockBits;
+    // victim cache (fully associative) and write buffer between L1 and L2
+    struct BufferedWrite {
+        address_t address;
+        double doneAt; // totalTime at which the entry reaches L2
+    };
+    bool hasVictimCache;
+    Cache victimCache;
+    unsigned vcCycle;
+    unsigned wbEntries, wbCycle;
+    std::deque<BufferedWrite> writeBuffer;
+    double vcAccesses, vcHits, wbWrites, wbHits, wbStallCycles;
+    // three c classification, per level
+    bool threeC;
+    std::vector<ShadowCache> shadows;
+    std::vector<std::unordered_set<address_t> > touched; // first touch set
+    std::vector<double> compulsory, capacity, conflict;
+
+    // set sampling - the low set index bits shared by every level pick the sampled buckets,
+    // so a sampled L1 set only ever sees blocks of sampled L2 sets (checkSimConfig rejects the hashed
+    // index functions, whose sets do not line up across levels)
+    struct SampleBucket {
+        std::vector<double> accesses, misses;
+        double time = 0;
+    };
+    unsigned sampleRatio, sampleBits;
+    std::vector<bool> sampled;
+    std::vector<SampleBucket> buckets;
+    double skipped;
+
+    // standard error of sum(num)/sum(den) over the sampled buckets
+    double ratioError(const std::vector<double>& num, const std::vector<double>& den) const {
+        double sumNum = 0, sumDen = 0, n = 0;
+        for (unsigned i = 0; i < num.size(); i++) {
+            if (sampled[i] && den[i] > 0) {
+                sumNum += num[i];
+                sumDen += den[i];
+                n++;
+            }
+        }
+        if (n < 2 || sumDen == 0) {
+            return 0;
+        }
+        double ratio = sumNum / sumDen, var = 0;
+        for (unsigned i = 0; i < num.size(); i++) {
+            if (sampled[i] && den[i] > 0) {
+                var += (num[i] - ratio * den[i]) * (num[i] - ratio * den[i]);
+            }
+        }
+        double population = num.size(); // finite population correction over all buckets
+        return std::sqrt(var / (n * (n - 1)) * (1 - n / population)) / (sumDen / n);
+    }
+
+    // non-blocking timing overlay - the functional state is updated at issue, the mshrs of
+    // each level track when in-flight blocks arrive so later accesses merge or stall on them
+    struct MshrEntry {
+        address_t block;
+        double readyAt;
+    };
+    bool timing;
+    unsigned issueRate;
+    std::vector<unsigned> mshrLimit;
+    std::vector<std::vector<MshrEntry> > mshrs;
+    int lastHitLevel; // hit level of the last simulated access, -1 if it was not simulated
+    double nextIssue, coreReady, lastCompletion, timedAccesses, latencySum;
+    double missLatencySum, missBusy, busyUntil; // memory level parallelism of the L1 misses
+    double mshrStalls, mshrStallCycles, mshrMerges;
+    // dram backend, NULL when memory is the fixed memCycle
+    std::unique_ptr<DramModel> dram;
+    double memNow; // issue cycle of the current access (timing mode)
+    double timeOrigin; // trace timestamp that is cycle 0 after a statistics reset
+    bool rebasePending; // timing mode - the clocks restart at the next issue after a reset
+    bool lastWrite;
+
+    // memory traffic - every block moved to or from memory goes through memTransfer
+    bool showTraffic;
+    double memBandwidth; // bytes per cycle, 0 = unlimited
+    double memBusFree; // cycle the memory bus finishes its queued transfers
+    double memReads, memWrites; // blocks
+    double wrAllocFills; // blocks filled because of a write miss
+    double bwStallCycles; // demand cycles spent waiting for the memory bus
+    // instruction cache next to L1 (combined core model), the levels below L1 are shared
+    bool hasL1I;
+    Cache l1i;
+    double l1iAccesses, l1iMisses;
+
+    // every statistics counter (and timing clock) kept outside the per level vectors, in checkpoint order
+    std::vector<double*> checkpointScalars() {
+        double* fixed[] = {&totalTime, &vcAccesses, &vcHits, &wbWrites, &wbHits, &wbStallCycles, &backInvalidations,
+                           &memReads, &memWrites, &wrAllocFills, &bwStallCycles, &memBusFree, &l1iAccesses, &l1iMisses,
+                           &skipped, &nextIssue, &coreReady, &lastCompletion, &timedAccesses,
+                           &latencySum, &missLatencySum, &missBusy, &busyUntil, &mshrStalls, &mshrStallCycles,
+                           &mshrMerges, &timeOrigin};
+        std::vector<double*> scalars(fixed, fixed + sizeof(fixed) / sizeof(fixed[0]));
+        for (unsigned k = 0; k < pfStats.size(); k++) {
+            scalars.push_back(&pfStats[k].issued);
+            scalars.push_back(&pfStats[k].useful);
+            scalars.push_back(&pfStats[k].late);
+            scalars.push_back(&pfStats[k].polluting);
+        }
+        for (unsigned i = 0; i < buckets.size(); i++) {
+            scalars.push_back(&buckets[i].time);
+        }
+        if (dram) {
+            double* counts[] = {&dram->reads, &dram->writes, &dram->rowHits, &dram->rowEmpty, &dram->rowConflicts,
+                                &dram->readLatency};
+            scalars.insert(scalars.end(), counts, counts + sizeof(counts) / sizeof(counts[0]));
+        }
+        return scalars;
+    }
+    // per level counter vectors, in checkpoint order
+    std::vector<std::vector<double>*> checkpointVectors() {
+        std::vector<double>* fixed[] = {&misses, &accesses, &levelTime, &writebacks, &compulsory, &capacity,
+                                        &conflict};
+        std::vector<std::vector<double>*> vectors(fixed, fixed + sizeof(fixed) / sizeof(fixed[0]));
+        for (unsigned i = 0; i < buckets.size(); i++) {
+            vectors.push_back(&buckets[i].accesses);
+            vectors.push_back(&buckets[i].misses);
+        }
+        return vectors;
+    }
+
+    // count one block transfer, returns the cycles it waits for the memory bus
+    double memTransfer(double now, bool write) {
+        if (write) {
+            memWrites++;
+        } else {
+            memReads++;
+        }
+        if (memBandwidth <= 0 || dram) {
+            return 0; // the dram model has its own bus
+        }
+        double start = std::max(now, memBusFree);
+        memBusFree = start + (double)((address_t)1 << blockBits) / memBandwidth;
+        return start - now;
+    }
+    // block leaving the last level, or a fill no demand waits for
+    void memTraffic(address_t address, bool write) {
+        double now = timing ? memNow : totalTime;
+        memTransfer(now, write);
+        if (dram) {
+            dram->access(address, now, write);
+        }
+    }
+    // memory latency of a demand access
+    double memLatency(address_t address, double now, bool write) {
+        double wait = memTransfer(now, write);
+        bwStallCycles += wait;
+        return dram ? dram->access(address, now, write) : memCycle + wait;
+    }
+
+    void retireMshrs(unsigned k, double now) {
+        std::vector<MshrEntry>& m = mshrs[k];
+        for (unsigned i = 0; i < m.size();) {
+            if (m[i].readyAt <= now) {
+                m[i] = m.back();
+                m.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+    // latency of the access just simulated, issued at cycle issue
+    void timeAccess(address_t address, double issue) {
+        issue = std::max(issue, coreReady);
+        address_t block = address >> blockBits;
+        unsigned h = lastHitLevel;
+        double cur = issue, missStart = -1;
+        std::vector<std::pair<unsigned, unsigned> > allocated; // (level, entry)
+        bool merged = false;
+        for (unsigned k = 0; k < levels.size() && k <= h; k++) {
+            cur += levels[k].getAccessTime();
+            retireMshrs(k, cur);
+            std::vector<MshrEntry>& m = mshrs[k];
+            unsigned i = 0;
+            while (i < m.size() && m[i].block != block) {
+                i++;
+            }
+            if (i < m.size()) {
+                // block still in flight at this level - wait for it
+                mshrMerges++;
+                if (k == 0) {
+                    missStart = cur;
+                }
+                cur = std::max(cur, m[i].readyAt);
+                merged = true;
+                break;
+            }
+            if (k == h) {
+                break;
+            }
+            if (mshrLimit[k] && m.size() >= mshrLimit[k]) {
+                // all mshrs busy - stall until the first one frees, the core stalls with it
+                double first = m[0].readyAt;
+                for (unsigned j = 1; j < m.size(); j++) {
+                    first = std::min(first, m[j].readyAt);
+                }
+                mshrStalls++;
+                mshrStallCycles += first - cur;
+                cur = first;
+                coreReady = std::max(coreReady, cur);
+                retireMshrs(k, cur);
+            }
+            if (k == 0) {
+                missStart = cur;
+            }
+            MshrEntry entry;
+            entry.block = block;
+            entry.readyAt = cur;
+            m.push_back(entry);
+            allocated.push_back(std::make_pair(k, (unsigned)m.size() - 1));
+        }
+        if (!merged && h == levels.size()) {
+            cur += memLatency(address, cur, lastWrite && !wrAlloc.back());
+        }
+        for (unsigned i = 0; i < allocated.size(); i++) {
+            mshrs[allocated[i].first][allocated[i].second].readyAt = cur;
+        }
+        if (missStart >= 0) {
+            missLatencySum += cur - missStart;
+            if (missStart >= busyUntil) {
+                missBusy += cur - missStart;
+                busyUntil = cur;
+            } else if (cur > busyUntil) {
+                missBusy += cur - busyUntil;
+                busyUntil = cur;
+            }
+        }
+        timedAccesses++;
+        latencySum += cur - issue;
+        lastCompletion = std::max(lastCompletion, cur);
+    }
+
+    // classify the demand access to level k before the lookup result is used
+    void classify(unsigned k, address_t address, bool hit, bool write) {
+        address_t block = address >> blockBits;
+        bool firstTouch = touched[k].insert(block).second;
+        bool shadowHit = shadows[k].access(block, !write || wrAlloc[k]);
+        if (hit) {
+            return;
+        }
+        if (firstTouch) {
+            compulsory[k]++;
+        } else if (!shadowHit) {
+            capacity[k]++;
+        } else {
+            conflict[k]++;
+        }
+    }
+
+    // retire write buffer entries that finished draining
+    void drainWriteBuffer() {
+        while (!writeBuffer.empty() && writeBuffer.front().doneAt <= totalTime) {
+            writeBack(0, writeBuffer.front().address);
+            writeBuffer.pop_front();
+        }
+    }
+    // dirty data leaving L1 (or the victim cache) towards L2
+    void writeBackL1(address_t address) {
+        if (wbEntries == 0) {
+            writeBack(0, address);
+            return;
+        }
+        wbWrites++;
+        drainWriteBuffer();
+        if (writeBuffer.size() >= wbEntries) {
+            // full - stall until the oldest entry is in L2
+            double stall = writeBuffer.front().doneAt - totalTime;
+            totalTime += stall;
+            levelTime[0] += stall;
+            wbStallCycles += stall;
+            drainWriteBuffer();
+        }
+        BufferedWrite bw;
+        bw.address = address;
+        bw.doneAt = (writeBuffer.empty() ? totalTime : std::max(totalTime, writeBuffer.back().doneAt)) + wbCycle;
+        writeBuffer.push_back(bw);
+    }
+    // L1 miss - a pending write to the block is forwarded, it goes to L2 first
+    void writeBufferLookup(address_t address) {
+        address_t block = address >> blockBits;
+        for (unsigned i = 0; i < writeBuffer.size(); i++) {
+            if ((writeBuffer[i].address >> blockBits) == block) {
+                wbHits++;
+                writeBack(0, writeBuffer[i].address);
+                writeBuffer.erase(writeBuffer.begin() + i);
+                return;
+            }
+        }
+    }
+    // L1 victim goes into the victim cache, the victim cache lru entry leaves
+    void toVictimCache(address_t address, bool isDirty) {
+        unsigned way = 0;
+        if (!victimCache.findVictim(address, way)) {
+            bool victimDirty = victimCache.isDirty(0, way);
+            if (victimDirty) {
+                writebacks[0]++;
+            }
+            if (exclusiveBelow(0)) {
+                fill(1, victimCache.getBlockAddress(0, way), victimDirty);
+            } else if (victimDirty) {
+                writeBackL1(victimCache.getBlockAddress(0, way));
+            }
+        }
+        victimCache.insertBlock(address, way, isDirty);
+        victimCache.updateLRU(0, way);
+    }
+
+    // the level below k only takes the victims of k
+    bool exclusiveBelow(unsigned k) const {
+        return k + 1 < levels.size() && inclusive[k + 1] == INCL_EXCLUSIVE;
+    }
+    // a level above k (or the victim cache / L1I in front of the shared levels) holds the block
+    bool heldAbove(unsigned k, address_t address) {
+        unsigned way;
+        for (unsigned j = 0; j < k; j++) {
+            if (levels[j].checkHit(address, way)) {
+                return true;
+            }
+        }
+        return k > 0 && ((hasVictimCache && victimCache.checkHit(address, way)) ||
+                         (hasL1I && l1i.checkHit(address, way)));
+    }
+    // write a dirty block back below level k - the first level holding it absorbs it
+    void writeBack(unsigned k, address_t address) {
+        for (unsigned j = k + 1; j < levels.size(); j++) {
+            unsigned way;
+            if (levels[j].checkHit(address, way)) {
+                unsigned index = levels[j].getIndex(address, way);
+                levels[j].setDirty(index, way);
+                levels[j].updateLRU(index, way); // snoop - zero time cost
+                return;
+            }
+        }
+        // else it goes to memory
+        memTraffic(address, true);
+    }
+    // bring address into level k, evicting by lru if the set is full
+    void fill(unsigned k, address_t address, bool isDirty, bool prefetch = false) {
+        CACHE_PROFILE_SCOPE(PROF_FILL);
+        Cache& cache = levels[k];
+        unsigned way = 0;
+        bool invalidWay = cache.findVictim(address, way); // find invalid or evicted- lru
+        unsigned index = cache.getIndex(address, way);
+        if (!invalidWay) {
+            if (cache.isValid(index, way)) {
+                address_t evictedAddr = cache.getBlockAddress(index, way);
+                bool wasDirty = cache.isDirty(index, way);
+                if (inclusive[k] == INCL_INCLUSIVE) {
+                    // invalidate from the levels above
+                    for (unsigned j = 0; j < k; j++) {
+                        unsigned aboveWay;
+                        if (levels[j].checkHit(evictedAddr, aboveWay)) {
+                            backInvalidations++;
+                            if (levels[j].invalidate(evictedAddr)) {
+                                wasDirty = true;
+                            }
+                        }
+                    }
+                    unsigned vcWay;
+                    if (hasVictimCache && k > 0 && victimCache.checkHit(evictedAddr, vcWay)) {
+                        backInvalidations++;
+                        if (victimCache.invalidate(evictedAddr)) {
+                            wasDirty = true;
+                        }
+                    }
+                    unsigned l1iWay;
+                    if (hasL1I && k > 0 && l1i.checkHit(evictedAddr, l1iWay)) {
+                        backInvalidations++;
+                        l1i.invalidate(evictedAddr); // instruction blocks are never dirty
+                    }
+                }
+                if (wasDirty && !(k == 0 && hasVictimCache)) {
+                    writebacks[k]++;
+                }
+                if (k == 0 && hasVictimCache) {
+                    toVictimCache(evictedAddr, wasDirty);
+                } else if (exclusiveBelow(k)) {
+                    fill(k + 1, evictedAddr, wasDirty); // the victim moves down, clean or dirty
+                } else if (k == 0 && wasDirty) {
+                    writeBackL1(evictedAddr);
+                } else if (wasDirty) {
+                    writeBack(k, evictedAddr);
+                }
+                if (prefetch && !pfVictimAt[k].count(evictedAddr >> blockBits)) {
+                    pfVictims[k].push_back(evictedAddr >> blockBits);
+                    pfVictimAt[k][evictedAddr >> blockBits] = --pfVictims[k].end();
+                    if (pfVictims[k].size() > (size_t)cache.getWays() << cache.getSetBits()) {
+                        forgetPfVictim(k, pfVictims[k].front());
+                    }
+                }
+            }
+        }
+        cache.insertBlock(address, way, isDirty);
+        cache.setPrefetched(index, way, prefetch);
+        cache.updateLRU(index, way);
+        if (!pfVictims[k].empty()) {
+            forgetPfVictim(k, address >> blockBits);
+        }
+    }
+    // drop a block from the prefetch victims of level k, false if it was not one
+    bool forgetPfVictim(unsigned k, address_t block) {
+        std::unordered_map<address_t, std::list<address_t>::iterator>::iterator it = pfVictimAt[k].find(block);
+        if (it == pfVictimAt[k].end()) {
+            return false;
+        }
+        pfVictims[k].erase(it->second);
+        pfVictimAt[k].erase(it);
+        return true;
+    }
+    // prefetch fill into level k - missing levels below are filled too to keep inclusion
+    void prefetchFill(unsigned k, address_t address) {
+        unsigned way;
+        if (k == 0 && hasVictimCache && victimCache.checkHit(address, way)) {
+            // swapped back like a demand victim cache hit, so the block is never in both
+            fill(0, address, victimCache.invalidate(address), true);
+            return;
+        }
+        if (k > 0 && inclusive[k] == INCL_EXCLUSIVE && heldAbove(k, address)) {
+            return; // moved up while the prefetch was in flight
+        }
+        unsigned h = k;
+        while (h < levels.size() && !levels[h].checkHit(address, way)) {
+            h++;
+        }
+        if (h > k && h < levels.size() && levels[h].isPrefetched(levels[h].getIndex(address, way), way)) {
+            pfStats[h].useful++; // consumed by the prefetcher above
+            levels[h].setPrefetched(levels[h].getIndex(address, way), way, false);
+        }
+        if (h == levels.size()) {
+            memTraffic(address, false);
+        }
+        bool carried = false; // dirty state of a block leaving an exclusive level
+        if (h > k && h < levels.size() && inclusive[h] == INCL_EXCLUSIVE) {
+            carried = levels[h].invalidate(address);
+        }
+        for (unsigned j = h; j-- > k;) {
+            if (j != k && inclusive[j] == INCL_EXCLUSIVE) {
+                continue;
+            }
+            fill(j, address, carried, j == k);
+            carried = false;
+        }
+    }
+    // queue new prefetches and fill the ones whose latency passed
+    void issuePrefetches(unsigned k, const std::vector<address_t>& blocks) {
+        for (unsigned i = 0; i < blocks.size(); i++) {
+            address_t address = blocks[i] << blockBits;
+            unsigned way;
+            if (pfQueue[k].size() >= pfQueueSize || levels[k].checkHit(address, way)) {
+                continue;
+            }
+            if (k > 0 && inclusive[k] == INCL_EXCLUSIVE && heldAbove(k, address)) {
+                continue; // an exclusive level never holds a copy of the levels above
+            }
+            bool queued = false;
+            for (unsigned j = 0; j < pfQueue[k].size() && !queued; j++) {
+                queued = (pfQueue[k][j].address == address);
+            }
+            if (queued) {
+                continue;
+            }
+            PendingPrefetch pf;
+            pf.address = address;
+            pf.readyAt = accesses[0] + pfLatency;
+            pfQueue[k].push_back(pf);
+            pfStats[k].issued++;
+        }
+        while (!pfQueue[k].empty() && pfQueue[k].front().readyAt <= accesses[0]) {
+            prefetchFill(k, pfQueue[k].front().address);
+            pfQueue[k].pop_front();
+        }
+    }
+    // demand access to level k - prefetch bookkeeping before the lookup
+    void prefetchDemand(unsigned k, address_t address) {
+        address_t block = address >> blockBits;
+        for (unsigned j = 0; j < pfQueue[k].size(); j++) {
+            if ((pfQueue[k][j].address >> blockBits) == block) {
+                pfStats[k].late++; // still in flight - the demand fetches it itself
+                pfQueue[k].erase(pfQueue[k].begin() + j);
+                break;
+            }
+        }
+        unsigned way;
+        if (levels[k].checkHit(address, way)) {
+            unsigned index = levels[k].getIndex(address, way);
+            if (levels[k].isPrefetched(index, way)) {
+                pfStats[k].useful++;
+                levels[k].setPrefetched(index, way, false);
+            }
+        } else if (forgetPfVictim(k, block)) {
+            pfStats[k].polluting++; // a prefetch pushed this block out
+        }
+    }
+
+public:
+    CacheSystem(const SimConfig& cfg)
+        : memCycle(cfg.MemCyc),
+          totalTime(0),
+          misses(cfg.levels.size(), 0),
+          accesses(cfg.levels.size(), 0),
+          levelTime(cfg.levels.size() + 1, 0),
+          writebacks(cfg.levels.size(), 0),
+          lastAccesses(cfg.levels.size(), 0),
+          lastMisses(cfg.levels.size(), 0),
+          lastWritebacks(cfg.levels.size(), 0),
+          lastLevelTime(cfg.levels.size() + 1, 0),
+          lastTotalTime(0),
+          intervals(0),
+          pfQueue(cfg.levels.size()),
+          pfVictims(cfg.levels.size()),
+          pfVictimAt(cfg.levels.size()),
+          pfStats(cfg.levels.size()),
+          pfQueueSize(cfg.PfQueue),
+          pfLatency(cfg.PfLatency),
+          blockBits(cfg.BSize),
+          hasVictimCache(cfg.VcEntries > 0),
+          victimCache(cfg.BSize + (unsigned)std::log2(cfg.VcEntries ? cfg.VcEntries : 1), cfg.BSize,
+                      (unsigned)std::log2(cfg.VcEntries ? cfg.VcEntries : 1), cfg.VcCyc),
+          vcCycle(cfg.VcCyc),
+          wbEntries(cfg.WbEntries),
+          wbCycle(cfg.WbCyc),
+          vcAccesses(0), vcHits(0), wbWrites(0), wbHits(0), wbStallCycles(0),
+          threeC(cfg.ThreeC != 0),
+          touched(cfg.levels.size()),
+          compulsory(cfg.levels.size(), 0),
+          capacity(cfg.levels.size(), 0),
+          conflict(cfg.levels.size(), 0),
+          sampleRatio(cfg.SampleRatio),
+          sampleBits(0),
+          skipped(0),
+          timing(cfg.Timing != 0),
+          issueRate(cfg.IssueRate),
+          mshrs(cfg.levels.size()),
+          lastHitLevel(-1),
+          nextIssue(0), coreReady(0), lastCompletion(0), timedAccesses(0), latencySum(0),
+          missLatencySum(0), missBusy(0), busyUntil(0),
+          mshrStalls(0), mshrStallCycles(0), mshrMerges(0),
+          dram(cfg.Dram ? new DramModel(cfg) : NULL),
+          memNow(0),
+          timeOrigin(0),
+          rebasePending(false),
+          lastWrite(false),
+          showTraffic(cfg.Traffic != 0 || cfg.MemBandwidth > 0),
+          memBandwidth(cfg.MemBandwidth),
+          memBusFree(0), memReads(0), memWrites(0), wrAllocFills(0), bwStallCycles(0),
+          hasL1I(cfg.L1ISize > 0),
+          l1i(std::max(cfg.L1ISize, cfg.BSize + cfg.L1IAssoc), cfg.BSize, cfg.L1IAssoc, cfg.L1ICyc),
+          l1iAccesses(0), l1iMisses(0) {
+        showInclusion = cfg.Inclusion >= 0;
+        backInvalidations = 0;
+        for (unsigned k = 0; k < cfg.levels.size(); k++) {
+            const LevelConfig& lv = cfg.levels[k];
+            levels.push_back(Cache(lv.Size, cfg.BSize, lv.Assoc, lv.Cyc, lv.Index));
+            wrAlloc.push_back(lv.WrAlloc < 0 ? cfg.WrAlloc : lv.WrAlloc);
+            inclusive.push_back(levelInclusion(cfg, k));
+            showInclusion = showInclusion || lv.Inclusive >= 0;
+            prefetchers.push_back(std::unique_ptr<Prefetcher>(makePrefetcher(lv.Prefetch, cfg.PfDegree)));
+            shadows.push_back(ShadowCache(threeC ? 1u << (lv.Size - cfg.BSize) : 0));
+            mshrLimit.push_back(lv.Mshr);
+        }
+        if (sampleRatio > 1) {
+            sampleBits = levels[0].getSetBits();
+            for (unsigned k = 1; k < levels.size(); k++) {
+                sampleBits = std::min(sampleBits, levels[k].getSetBits());
+            }
+            unsigned n = 1u << sampleBits;
+            sampled.assign(n, false);
+            for (unsigned i = 0; i < n; i++) {
+                sampled[i] = ((i * 2654435761u) >> 8) % sampleRatio == 0; // index hash
+            }
+            sampled[0] = true; // never sample nothing
+            SampleBucket empty;
+            empty.accesses.assign(levels.size(), 0);
+            empty.misses.assign(levels.size(), 0);
+            buckets.assign(n, empty);
+        }
+    }
+    // access to memory hir
+    void access(address_t address, char operation) {
+        accessAt(address, operation, -1);
+    }
+    // access issued at a given cycle (timing mode), issue < 0 means the fixed issue rate
+    void accessAt(address_t address, char operation, double issue) {
+        if (issue < 0) {
+            issue = nextIssue;
+        } else {
+            issue -= timeOrigin;
+        }
+        if (rebasePending) {
+            double origin = std::max(issue, coreReady); // the cycle the access really issues
+            rebaseClocks(origin);
+            timeOrigin += origin;
+            issue = 0;
+            rebasePending = false;
+        }
+        nextIssue = issue + issueRate;
+        memNow = std::max(issue, coreReady);
+        lastWrite = (operation == 'w');
+        lastHitLevel = -1;
+        sampledAccess(address, operation);
+        if (timing && lastHitLevel >= 0) {
+            timeAccess(address, issue);
+        }
+    }
+    // set sampling filter in front of simulate
+    void sampledAccess(address_t address, char operation) {
+        if (sampleRatio <= 1) {
+            simulate(address, operation);
+            return;
+        }
+        SampleBucket& bucket = buckets[(address >> blockBits) & ((1u << sampleBits) - 1)];
+        if (!sampled[(address >> blockBits) & ((1u << sampleBits) - 1)]) {
+            skipped++; // not a sampled set - stop after the index
+            return;
+        }
+        std::vector<double> accBefore = accesses, missBefore = misses;
+        double timeBefore = totalTime;
+        simulate(address, operation);
+        for (unsigned k = 0; k < levels.size(); k++) {
+            bucket.accesses[k] += accesses[k] - accBefore[k];
+            bucket.misses[k] += misses[k] - missBefore[k];
+        }
+        bucket.time += totalTime - timeBefore;
+    }
+    // instruction fetch - L1I, then the shared levels below L1 as a read
+    // returns the fetch time, which is kept out of the data AccTimeAvg
+    double fetch(address_t address) {
+        double time = l1i.getAccessTime();
+        l1iAccesses++;
+        unsigned way = 0;
+        if (l1i.checkHit(address, way)) {
+            l1i.updateLRU(l1i.getIndex(address, way), way);
+            return time;
+        }
+        l1iMisses++;
+        unsigned hitLevel = levels.size();
+        for (unsigned k = 1; k < levels.size(); k++) {
+            accesses[k]++;
+            time += levels[k].getAccessTime();
+            levelTime[k] += levels[k].getAccessTime();
+            if (levels[k].checkHit(address, way)) {
+                hitLevel = k;
+                break;
+            }
+            misses[k]++;
+        }
+        bool carried = false; // dirty state of a block leaving an exclusive level
+        if (hitLevel == levels.size()) {
+            double mem = memLatency(address, totalTime, false);
+            time += mem;
+            levelTime[levels.size()] += mem;
+        } else if (inclusive[hitLevel] == INCL_EXCLUSIVE) {
+            carried = levels[hitLevel].invalidate(address); // exclusive - the block moves up
+        } else {
+            levels[hitLevel].updateLRU(levels[hitLevel].getIndex(address, way), way);
+        }
+        // the same fills as a data read, exclusive levels are skipped
+        for (unsigned k = hitLevel; k-- > 1;) {
+            if (inclusive[k] != INCL_EXCLUSIVE) {
+                fill(k, address, carried);
+                carried = false;
+            }
+        }
+        if (carried) {
+            writeBack(hitLevel, address); // the L1I cannot hold the dirty data
+        }
+        if (!l1i.findVictim(address, way) && l1i.isValid(l1i.getIndex(address, way), way)) {
+            // an lru victim is clean - dropped, unless an exclusive L2 takes the victims
+            address_t evictedAddr = l1i.getBlockAddress(l1i.getIndex(address, way), way);
+            unsigned dataWay;
+            if (exclusiveBelow(0) && !levels[0].checkHit(evictedAddr, dataWay) &&
+                !(hasVictimCache && victimCache.checkHit(evictedAddr, dataWay))) {
+                fill(1, evictedAddr, false);
+            }
+        }
+        l1i.insertBlock(address, way, false);
+        l1i.updateLRU(l1i.getIndex(address, way), way);
+        return time;
+    }
+    // one access through the hierarchy
+    void simulate(address_t address, char operation) {
+        bool write = (operation == 'w');
+        // walk down until a hit
+        unsigned hitLevel = levels.size();
+        unsigned way = 0;
+        for (unsigned k = 0; k < levels.size(); k++) {
+            accesses[k]++;
+            totalTime += levels[k].getAccessTime();
+            levelTime[k] += levels[k].getAccessTime();
+            if (prefetchers[k]) {
+                prefetchDemand(k, address);
+            }
+            bool hit = levels[k].checkHit(address, way);
+            if (threeC) {
+                classify(k, address, hit, write);
+            }
+            if (hit) {
+                hitLevel = k;
+                break;
+            }
+            misses[k]++;
+            if (k == 0 && wbEntries > 0) {
+                drainWriteBuffer();
+                writeBufferLookup(address);
+            }
+            if (k == 0 && hasVictimCache) {
+                vcAccesses++;
+                totalTime += vcCycle;
+                levelTime[0] += vcCycle;
+                unsigned vcWay;
+                if (victimCache.checkHit(address, vcWay)) {
+                    // swap back into L1, L2 does not see the access
+                    vcHits++;
+                    lastHitLevel = 0;
+                    bool wasDirty = victimCache.invalidate(address);
+                    fill(0, address, wasDirty || write);
+                    if (prefetchers[0]) {
+                        std::vector<address_t> blocks;
+                        prefetchers[0]->train(address >> blockBits, false, blocks);
+                        issuePrefetches(0, blocks);
+                    }
+                    return;
+                }
+            }
+        }
+        lastHitLevel = hitLevel;
+        if (hitLevel == levels.size()) {
+            // in timing mode the memory sees the demand when timeAccess reaches it
+            // a write that allocates in the last level reads the block like a load
+            bool memWrite = write && !wrAlloc.back();
+            double mem = timing ? memCycle : memLatency(address, totalTime, memWrite);
+            totalTime += mem;
+            levelTime[levels.size()] += mem;
+        }
+        bool carried = false; // dirty state of a block leaving an exclusive level
+        if (hitLevel < levels.size() && hitLevel > 0 && inclusive[hitLevel] == INCL_EXCLUSIVE &&
+            !(write && !wrAlloc[hitLevel - 1])) {
+            carried = levels[hitLevel].invalidate(address); // exclusive - the block moves up
+        } else if (hitLevel < levels.size()) {
+            unsigned index = levels[hitLevel].getIndex(address, way);
+            if (write && (hitLevel == 0 || !wrAlloc[hitLevel - 1])) {
+                levels[hitLevel].setDirty(index, way); // write is absorbed here
+            }
+            levels[hitLevel].updateLRU(index, way);
+        }
+        // fill the missing levels from the bottom up, the top filled level takes the write
+        // exclusive levels are skipped, they only get victims
+        for (unsigned k = hitLevel; k-- > 0;) {
+            if ((write && !wrAlloc[k]) || (k > 0 && inclusive[k] == INCL_EXCLUSIVE)) {
+                continue;
+            }
+            fill(k, address, (write && (k == 0 || !wrAlloc[k - 1])) || carried);
+            carried = false;
+            if (write) {
+                wrAllocFills++;
+            }
+        }
+        // train the prefetchers of every level the demand reached
+        for (unsigned k = 0; k <= hitLevel && k < levels.size(); k++) {
+            if (prefetchers[k]) {
+                std::vector<address_t> blocks;
+                prefetchers[k]->train(address >> blockBits, k == hitLevel, blocks);
+                issuePrefetches(k, blocks);
+            }
+        }
+    }
+    // checkpoint - every level, the victim cache, every counter statistics() prints and the 3c
+    // shadows / first touch sets, then the in flight state - write buffer, prefetch queues and
+    // prefetcher tables, mshrs, the dram banks and the L1I - so a restored run continues exactly
+    bool saveCheckpoint(FILE* out) {
+        unsigned header[2] = {CHECKPOINT_MAGIC, (unsigned)levels.size()};
+        if (fwrite(header, sizeof(header), 1, out) != 1) {
+            return false;
+        }
+        for (unsigned k = 0; k < levels.size(); k++) {
+            if (!levels[k].save(out)) {
+                return false;
+            }
+        }
+        if (!victimCache.save(out)) {
+            return false;
+        }
+        std::vector<double*> scalarPtrs = checkpointScalars();
+        std::vector<double> scalars(1, (double)intervals);
+        for (unsigned i = 0; i < scalarPtrs.size(); i++) {
+            scalars.push_back(*scalarPtrs[i]);
+        }
+        if (!saveCounters(out, scalars)) {
+            return false;
+        }
+        std::vector<std::vector<double>*> vectors = checkpointVectors();
+        for (unsigned i = 0; i < vectors.size(); i++) {
+            if (!saveCounters(out, *vectors[i])) {
+                return false;
+            }
+        }
+        // the state the three c and polluting prefetch counts build on
+        for (unsigned k = 0; k < levels.size(); k++) {
+            if (!shadows[k].save(out) || !saveItems(out, touched[k]) || !saveItems(out, pfVictims[k])) {
+                return false;
+            }
+            if (!saveItems(out, pfQueue[k]) || !saveItems(out, mshrs[k]) ||
+                (prefetchers[k] && !prefetchers[k]->save(out))) {
+                return false;
+            }
+        }
+        return saveItems(out, writeBuffer) && l1i.save(out) && (!dram || dram->save(out));
+    }
+    bool loadCheckpoint(FILE* in) {
+        unsigned header[2];
+        if (fread(header, sizeof(header), 1, in) != 1 || header[0] != CHECKPOINT_MAGIC || header[1] != levels.size()) {
+            return false;
+        }
+        for (unsigned k = 0; k < levels.size(); k++) {
+            if (!levels[k].load(in)) {
+                return false;
+            }
+        }
+        std::vector<double*> scalarPtrs = checkpointScalars();
+        std::vector<double> scalars(scalarPtrs.size() + 1);
+        if (!victimCache.load(in) || !loadCounters(in, scalars)) {
+            return false;
+        }
+        intervals = (unsigned long)scalars[0];
+        for (unsigned i = 0; i < scalarPtrs.size(); i++) {
+            *scalarPtrs[i] = scalars[i + 1];
+        }
+        std::vector<std::vector<double>*> vectors = checkpointVectors();
+        for (unsigned i = 0; i < vectors.size(); i++) {
+            if (!loadCounters(in, *vectors[i])) {
+                return false;
+            }
+        }
+        for (unsigned k = 0; k < levels.size(); k++) {
+            if (!shadows[k].load(in) || !loadItems(in, touched[k]) || !loadItems(in, pfVictims[k])) {
+                return false;
+            }
+            pfVictimAt[k].clear();
+            for (std::list<address_t>::iterator it = pfVictims[k].begin(); it != pfVictims[k].end(); ++it) {
+                pfVictimAt[k][*it] = it;
+            }
+            if (!loadItems(in, pfQueue[k]) || !loadItems(in, mshrs[k]) ||
+                (prefetchers[k] && !prefetchers[k]->load(in))) {
+                return false;
+            }
+        }
+        if (!loadItems(in, writeBuffer) || !l1i.load(in) || (dram && !dram->load(in))) {
+            return false;
+        }
+        lastAccesses = accesses;
+        lastMisses = misses;
+        lastWritebacks = writebacks;
+        lastLevelTime = levelTime;
+        lastTotalTime = totalTime;
+        return true;
+    }
+    // move every timing mode clock back by offset - the reset issue becomes cycle 0
+    void rebaseClocks(double offset) {
+        double* clocks[] = {&nextIssue, &coreReady, &lastCompletion, &busyUntil, &memBusFree};
+        for (unsigned i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+            *clocks[i] = std::max(*clocks[i] - offset, 0.0);
+        }
+        for (unsigned k = 0; k < mshrs.size(); k++) {
+            for (unsigned i = 0; i < mshrs[k].size(); i++) {
+                mshrs[k][i].readyAt = std::max(mshrs[k][i].readyAt - offset, 0.0);
+            }
+        }
+        if (dram) {
+            dram->rebase(offset);
+        }
+    }
+    // zero the counters but keep the cache contents (region of interest after warm up)
+    void resetStatistics() {
+        timedAccesses = latencySum = missLatencySum = missBusy = 0;
+        mshrStalls = mshrStallCycles = mshrMerges = 0;
+        backInvalidations = 0;
+        if (dram) {
+            if (!timing) {
+                dram->rebase(totalTime); // the serial clock restarts with totalTime
+            }
+            dram->resetStatistics();
+        }
+        if (!timing) {
+            memBusFree = std::max(memBusFree - totalTime, 0.0);
+        }
+        rebasePending = timing;
+        for (unsigned i = 0; i < writeBuffer.size(); i++) {
+            writeBuffer[i].doneAt = std::max(writeBuffer[i].doneAt - totalTime, 0.0);
+        }
+        for (unsigned k = 0; k < pfQueue.size(); k++) {
+            for (unsigned i = 0; i < pfQueue[k].size(); i++) {
+                pfQueue[k][i].readyAt = std::max(pfQueue[k][i].readyAt - accesses[0], 0.0); // counted in accesses
+            }
+        }
+        skipped = 0;
+        for (unsigned i = 0; i < buckets.size(); i++) {
+            std::fill(buckets[i].accesses.begin(), buckets[i].accesses.end(), 0);
+            std::fill(buckets[i].misses.begin(), buckets[i].misses.end(), 0);
+            buckets[i].time = 0;
+        }
+        memReads = memWrites = wrAllocFills = bwStallCycles = 0;
+        l1iAccesses = l1iMisses = 0;
+        totalTime = vcAccesses = vcHits = wbWrites = wbHits = wbStallCycles = 0;
+        std::fill(misses.begin(), misses.end(), 0);
+        std::fill(accesses.begin(), accesses.end(), 0);
+        std::fill(levelTime.begin(), levelTime.end(), 0);
+        std::fill(writebacks.begin(), writebacks.end(), 0);
+        std::fill(compulsory.begin(), compulsory.end(), 0);
+        std::fill(capacity.begin(), capacity.end(), 0);
+        std::fill(conflict.begin(), conflict.end(), 0);
+        for (unsigned k = 0; k < pfStats.size(); k++) {
+            pfStats[k] = PrefetchStats();
+        }
+        lastAccesses = accesses;
+        lastMisses = misses;
+        lastWritebacks = writebacks;
+        lastLevelTime = levelTime;
+        lastTotalTime = 0;
+        intervals = 0;
+    }
+    // batched access - one call per span of records, returns the cumulative statistics
+    CacheStats accessBatch(const TraceRecord* records, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            access(records[i].address, records[i].operation);
+        }
+        return getStats();
+    }
+    CacheStats getStats() const {
+        CacheStats stats;
+        stats.levels = levels.size();
+        for (unsigned k = 0; k < levels.size() && k < CACHE_MAX_LEVELS; k++) {
+            stats.accesses[k] = accesses[k];
+            stats.misses[k] = misses[k];
+            stats.writebacks[k] = writebacks[k];
+        }
+        stats.totalTime = totalTime;
+        return stats;
+    }
+    // demand accesses so far
+    double getAccesses() const {
+        return accesses[0];
+    }
+    // serial data access time so far
+    double getTotalTime() const {
+        return totalTime;
+    }
+    // csv header of the interval records
+    std::string intervalHeader() const {
+        std::string out = "interval,end";
+        for (unsigned k = 0; k < levels.size(); k++) {
+            appendf(out, ",L%uacc,L%umiss,L%uwb,L%uamat", k + 1, k + 1, k + 1, k + 1);
+        }
+        return out + ",AccTimeAvg\n";
+    }
+    // statistics of the accesses since the previous record, as a csv row or a json line
+    std::string intervalRecord(bool json) {
+        CACHE_PROFILE_SCOPE(PROF_OUTPUT);
+        std::string out;
+        appendf(out, json ? "{\"interval\":%lu,\"end\":%.0f" : "%lu,%.0f", intervals++, accesses[0]);
+        for (unsigned k = 0; k < levels.size(); k++) {
+            double acc = accesses[k] - lastAccesses[k];
+            double miss = misses[k] - lastMisses[k];
+            double time = 0;
+            for (unsigned j = k; j <= levels.size(); j++) {
+                time += levelTime[j] - lastLevelTime[j];
+            }
+            float missRate = (float)(acc ? miss / acc : 0);
+            float amat = (float)(acc ? time / acc : 0);
+            if (json) {
+                appendf(out, ",\"L%u\":{\"accesses\":%.0f,\"missRate\":%.03f,\"writebacks\":%.0f,\"amat\":%.03f}",
+                        k + 1, acc, missRate, writebacks[k] - lastWritebacks[k], amat);
+            } else {
+                appendf(out, ",%.0f,%.03f,%.0f,%.03f", acc, missRate, writebacks[k] - lastWritebacks[k], amat);
+            }
+        }
+        double acc = accesses[0] - lastAccesses[0];
+        float amat = (float)(acc ? (totalTime - lastTotalTime) / acc : 0);
+        appendf(out, json ? ",\"AccTimeAvg\":%.03f}\n" : ",%.03f\n", amat);
+        lastAccesses = accesses;
+        lastMisses = misses;
+        lastWritebacks = writebacks;
+        lastLevelTime = levelTime;
+        lastTotalTime = totalTime;
+        return out;
+    }
+    //print statistics
+    void print_statistics() const {
+        CACHE_PROFILE_SCOPE(PROF_OUTPUT);
+        printf("%s\n", statistics().c_str());
+    }
+    // statistics line without newline (used by the sweep rows)
+    // per level amat is only added when the hierarchy is not the default L1/L2
+    std::string statistics() const {
+        CACHE_PROFILE_SCOPE(PROF_OUTPUT);
+        std::string out;
+        for (unsigned k = 0; k < levels.size(); k++) {
+            appendf(out, "L%umiss=%.03f ", k + 1, (float)misses[k] / accesses[k]);
+        }
+        if (levels.size() != 2) {
+            for (unsigned k = 1; k < levels.size(); k++) {
+                double time = 0;
+                for (unsigned j = k; j <= levels.size(); j++) {
+                    time += levelTime[j];
+                }
+                appendf(out, "L%uAMAT=%.03f ", k + 1, (float)time / accesses[k]);
+            }
+        }
+        appendf(out, "AccTimeAvg=%.03f", (float)totalTime / accesses[0]);
+        if (timing) {
+            appendf(out, " Cycles=%.0f AchievedLatency=%.03f MLP=%.03f", lastCompletion,
+                    (float)(timedAccesses ? latencySum / timedAccesses : 0),
+                    (float)(missBusy ? missLatencySum / missBusy : 0));
+            appendf(out, " MshrStalls=%.0f MshrStallCycles=%.0f MshrMerges=%.0f",
+                    mshrStalls, mshrStallCycles, mshrMerges);
+        }
+        if (hasL1I) {
+            appendf(out, " L1Imiss=%.03f", (float)(l1iAccesses ? l1iMisses / l1iAccesses : 0));
+        }
+        if (showTraffic) {
+            for (unsigned k = 0; k < levels.size(); k++) {
+                appendf(out, " L%uWB=%.0f", k + 1, writebacks[k]);
+            }
+            double blockBytes = (double)((address_t)1 << blockBits);
+            double cycles = timing ? lastCompletion : totalTime;
+            appendf(out, " MemReadBytes=%.0f MemWriteBytes=%.0f WrAllocBytes=%.0f",
+                    memReads * blockBytes, memWrites * blockBytes, wrAllocFills * blockBytes);
+            appendf(out, " MemBW=%.03f BwStallCycles=%.0f",
+                    (float)(cycles ? (memReads + memWrites) * blockBytes / cycles : 0), bwStallCycles);
+        }
+        if (showInclusion) {
+            // distinct blocks held by the whole hierarchy (L1I included) against the sum of the level sizes
+            std::unordered_set<address_t> distinct;
+            double capacity = 0;
+            for (unsigned k = 0; k < levels.size(); k++) {
+                unsigned sets = 1u << levels[k].getSetBits();
+                capacity += (double)sets * levels[k].getWays();
+                for (unsigned i = 0; i < sets; i++) {
+                    for (unsigned w = 0; w < levels[k].getWays(); w++) {
+                        if (levels[k].isValid(i, w)) {
+                            distinct.insert(levels[k].getBlockAddress(i, w));
+                        }
+                    }
+                }
+            }
+            if (hasL1I) {
+                unsigned sets = 1u << l1i.getSetBits();
+                capacity += (double)sets * l1i.getWays();
+                for (unsigned i = 0; i < sets; i++) {
+                    for (unsigned w = 0; w < l1i.getWays(); w++) {
+                        if (l1i.isValid(i, w)) {
+                            distinct.insert(l1i.getBlockAddress(i, w));
+                        }
+                    }
+                }
+            }
+            appendf(out, " BackInval=%.0f EffCapacity=%.0f EffRatio=%.03f", backInvalidations,
+                    (double)distinct.size() * ((address_t)1 << blockBits), (float)(distinct.size() / capacity));
+        }
+        if (dram) {
+            double requests = dram->reads + dram->writes;
+            appendf(out, " DramReads=%.0f DramWrites=%.0f", dram->reads, dram->writes);
+            appendf(out, " DramRowHit=%.03f DramConflict=%.03f DramLatency=%.03f",
+                    (float)(requests ? dram->rowHits / requests : 0),
+                    (float)(requests ? dram->rowConflicts / requests : 0),
+                    (float)(dram->reads ? dram->readLatency / dram->reads : 0));
+        }
+        if (sampleRatio > 1) {
+            unsigned kept = 0;
+            for (unsigned i = 0; i < sampled.size(); i++) {
+                kept += sampled[i];
+            }
+            appendf(out, " SampledBuckets=%u/%u Skipped=%.0f", kept, (unsigned)sampled.size(), skipped);
+            std::vector<double> num(buckets.size()), den(buckets.size());
+            for (unsigned k = 0; k < levels.size(); k++) {
+                for (unsigned i = 0; i < buckets.size(); i++) {
+                    num[i] = buckets[i].misses[k];
+                    den[i] = buckets[i].accesses[k];
+                }
+                appendf(out, " L%umissErr=%.03f", k + 1, (float)ratioError(num, den));
+            }
+            for (unsigned i = 0; i < buckets.size(); i++) {
+                num[i] = buckets[i].time;
+                den[i] = buckets[i].accesses[0];
+            }
+            appendf(out, " AccTimeAvgErr=%.03f", (float)ratioError(num, den));
+        }
+        if (threeC) {
+            for (unsigned k = 0; k < levels.size(); k++) {
+                appendf(out, " L%uCompulsory=%.0f L%uCapacity=%.0f L%uConflict=%.0f",
+                        k + 1, compulsory[k], k + 1, capacity[k], k + 1, conflict[k]);
+            }
+        }
+        if (hasVictimCache) {
+            appendf(out, " VcHits=%.0f VcHitRate=%.03f", vcHits,
+                    (float)(vcAccesses ? vcHits / vcAccesses : 0));
+        }
+        if (wbEntries > 0) {
+            appendf(out, " WbWrites=%.0f WbHits=%.0f WbStallCycles=%.0f", wbWrites, wbHits, wbStallCycles);
+        }
+        // prefetch statistics only for levels with a prefetcher
+        for (unsigned k = 0; k < levels.size(); k++) {
+            if (!prefetchers[k]) {
+                continue;
+            }
+            const PrefetchStats& pf = pfStats[k];
+            appendf(out, " L%uPfIssued=%.0f L%uPfUseful=%.0f", k + 1, pf.issued, k + 1, pf.useful);
+            appendf(out, " L%uPfLate=%.0f L%uPfPolluting=%.0f", k + 1, pf.late, k + 1, pf.polluting);
+            appendf(out, " L%uPfAccuracy=%.03f L%uPfCoverage=%.03f", k + 1,
+                    (float)(pf.issued ? pf.useful / pf.issued : 0), k + 1,
+                    (float)(pf.useful + misses[k] ? pf.useful / (pf.useful + misses[k]) : 0));
+        }
+        return out;
+    }
+};
+// multi core system - private L1 per core, levels 2..n shared, mesi snooping bus between the L1s
+// the shared levels follow the same fill / back-invalidate rules as CacheSystem
+class MultiCoreSystem {
+private:
+    struct CoreStats {
+        double accesses = 0, misses = 0, coherenceMisses = 0;
+        double upgrades = 0; // S -> M bus upgrades
+        double invalidationsRecv = 0; // lines lost to other cores writes
+        double time = 0;
+    };
+    unsigned memCycle;
+    unsigned blockBits;
+    std::vector<Cache> l1; // one per core
+    std::vector<Cache> shared; // shared[0] is L2
+    unsigned l1WrAlloc;
+    std::vector<unsigned> wrAlloc; // per shared level
+    std::vector<unsigned> inclusive; // per shared level
+    std::vector<CoreStats> cores;
+    std::vector<std::unordered_set<address_t> > lostToCoherence; // per core blocks invalidated by a remote write
+    std::vector<double> misses, accesses;
+    double busRd, busRdX, busUpgr, flushes, cacheToCache, invalidations, backInvalidations;
+
+    address_t blockOf(address_t address) {
+        return address & ~(((address_t)1 << blockBits) - 1);
+    }
+
+    // write a dirty block back into the shared levels
+    void writeBack(unsigned from, address_t address) {
+        for (unsigned j = from; j < shared.size(); j++) {
+            unsigned way;
+            if (shared[j].checkHit(address, way)) {
+                unsigned index = shared[j].getIndex(address, way);
+                shared[j].setDirty(index, way);
+                shared[j].updateLRU(index, way);
+                return;
+            }
+        }
+    }
+    // snoop every other L1 - a write invalidates them, a read downgrades them to S
+    // returns true if another L1 holds the block
+    bool snoop(unsigned core, address_t address, bool write) {
+        bool found = false;
+        for (unsigned c = 0; c < l1.size(); c++) {
+            unsigned way;
+            if (c == core || !l1[c].checkHit(address, way)) {
+                continue;
+            }
+            found = true;
+            unsigned index = l1[c].getIndex(address, way);
+            if (l1[c].isDirty(index, way)) {
+                flushes++; // M supplies the data and writes it back
+                writeBack(0, address);
+            }
+            if (write) {
+                l1[c].invalidate(address);
+                invalidations++;
+                cores[c].invalidationsRecv++;
+                lostToCoherence[c].insert(blockOf(address));
+            } else {
+                if (!l1[c].isShared(index, way)) {
+                    cacheToCache++; // E or M copy answers the read
+                }
+                l1[c].clearDirty(index, way);
+                l1[c].setShared(index, way, true);
+            }
+        }
+        return found;
+    }
+    void fillShared(unsigned k, address_t address) {
+        Cache& cache = shared[k];
+        unsigned way = 0;
+        bool invalidWay = cache.findVictim(address, way);
+        unsigned index = cache.getIndex(address, way);
+        if (!invalidWay) {
+            if (cache.isValid(index, way)) {
+                address_t evictedAddr = cache.getBlockAddress(index, way);
+                bool wasDirty = cache.isDirty(index, way);
+                if (inclusive[k] == INCL_INCLUSIVE) {
+                    for (unsigned c = 0; c < l1.size(); c++) {
+                        unsigned l1Way;
+                        if (l1[c].checkHit(evictedAddr, l1Way)) {
+                            backInvalidations++; // inclusion victim in a private L1
+                            if (l1[c].invalidate(evictedAddr)) {
+                                wasDirty = true;
+                            }
+                        }
+                    }
+                    for (unsigned j = 0; j < k; j++) {
+                        if (shared[j].invalidate(evictedAddr)) {
+                            wasDirty = true;
+                        }
+                    }
+                }
+                if (wasDirty) {
+                    writeBack(k + 1, evictedAddr);
+                }
+            }
+        }
+        cache.insertBlock(address, way, false);
+        cache.updateLRU(index, way);
+    }
+
+public:
+    MultiCoreSystem(const SimConfig& cfg, unsigned numCores)
+        : memCycle(cfg.MemCyc), blockBits(cfg.BSize), cores(numCores), lostToCoherence(numCores),
+          misses(cfg.levels.size() - 1, 0), accesses(cfg.levels.size() - 1, 0),
+          busRd(0), busRdX(0), busUpgr(0), flushes(0), cacheToCache(0), invalidations(0),
+          backInvalidations(0) {
+        const LevelConfig& lv1 = cfg.levels[0];
+        for (unsigned c = 0; c < numCores; c++) {
+            l1.push_back(Cache(lv1.Size, cfg.BSize, lv1.Assoc, lv1.Cyc, lv1.Index));
+        }
+        l1WrAlloc = lv1.WrAlloc < 0 ? cfg.WrAlloc : lv1.WrAlloc;
+        for (unsigned k = 1; k < cfg.levels.size(); k++) {
+            const LevelConfig& lv = cfg.levels[k];
+            shared.push_back(Cache(lv.Size, cfg.BSize, lv.Assoc, lv.Cyc, lv.Index));
+            wrAlloc.push_back(lv.WrAlloc < 0 ? cfg.WrAlloc : lv.WrAlloc);
+            inclusive.push_back(levelInclusion(cfg, k)); // exclusive is rejected by checkMultiCoreConfig
+        }
+    }
+    void access(unsigned core, address_t address, char operation) {
+        CoreStats& cs = cores[core];
+        Cache& L1 = l1[core];
+        bool write = (operation == 'w');
+        cs.accesses++;
+        cs.time += L1.getAccessTime();
+        unsigned way = 0;
+        if (L1.checkHit(address, way)) {
+            unsigned index = L1.getIndex(address, way);
+            if (write && !L1.isDirty(index, way)) {
+                if (L1.isShared(index, way)) {
+                    // S -> M needs the other copies gone
+                    busUpgr++;
+                    cs.upgrades++;
+                    cs.time += shared[0].getAccessTime();
+                    snoop(core, address, true);
+                }
+                L1.setDirty(index, way); // E -> M is silent
+                L1.setShared(index, way, false);
+            }
+            L1.updateLRU(index, way);
+            return;
+        }
+        cs.misses++;
+        if (lostToCoherence[core].erase(blockOf(address))) {
+            cs.coherenceMisses++;
+        }
+        if (write) {
+            busRdX++;
+        } else {
+            busRd++;
+        }
+        bool others = snoop(core, address, write);
+        // shared levels
+        unsigned hitLevel = shared.size();
+        for (unsigned k = 0; k < shared.size(); k++) {
+            accesses[k]++;
+            cs.time += shared[k].getAccessTime();
+            if (shared[k].checkHit(address, way)) {
+                hitLevel = k;
+                break;
+            }
+            misses[k]++;
+        }
+        if (hitLevel == shared.size()) {
+            cs.time += memCycle;
+        } else {
+            unsigned index = shared[hitLevel].getIndex(address, way);
+            if (write && (hitLevel == 0 ? !l1WrAlloc : !wrAlloc[hitLevel - 1])) {
+                shared[hitLevel].setDirty(index, way);
+            }
+            shared[hitLevel].updateLRU(index, way);
+        }
+        for (unsigned k = hitLevel; k-- > 0;) {
+            if (!write || wrAlloc[k]) {
+                fillShared(k, address);
+            }
+        }
+        if (write && !l1WrAlloc) {
+            // no write allocate - the write goes below, mark it dirty in the first shared level holding it
+            writeBack(0, address);
+            return;
+        }
+        unsigned way1 = 0;
+        bool invalidWay = L1.findVictim(address, way1);
+        unsigned index = L1.getIndex(address, way1);
+        if (!invalidWay) {
+            if (L1.isValid(index, way1) && L1.isDirty(index, way1)) {
+                writeBack(0, L1.getBlockAddress(index, way1));
+            }
+        }
+        L1.insertBlock(address, way1, write); // M on write, else E or S
+        L1.setShared(index, way1, others && !write);
+        L1.updateLRU(index, way1);
+    }
+    void print_statistics() const {
+        CACHE_PROFILE_SCOPE(PROF_OUTPUT);
+        double acc = 0, miss = 0, time = 0;
+        for (unsigned c = 0; c < cores.size(); c++) {
+            const CoreStats& cs = cores[c];
+            printf("core%u: L1miss=%.03f CohMiss=%.0f Upgrades=%.0f InvRecv=%.0f AccTimeAvg=%.03f\n", c,
+                   (float)(cs.misses / cs.accesses), cs.coherenceMisses, cs.upgrades,
+                   cs.invalidationsRecv, (float)(cs.time / cs.accesses));
+            acc += cs.accesses;
+            miss += cs.misses;
+            time += cs.time;
+        }
+        printf("L1miss=%.03f ", (float)(miss / acc));
+        for (unsigned k = 0; k < shared.size(); k++) {
+            printf("L%umiss=%.03f ", k + 2, (float)(misses[k] / accesses[k]));
+        }
+        printf("AccTimeAvg=%.03f\n", (float)(time / acc));
+        printf("BusRd=%.0f BusRdX=%.0f BusUpgr=%.0f Flushes=%.0f CacheToCache=%.0f Invalidations=%.0f BackInvalidations=%.0f\n",
+               busRd, busRdX, busUpgr, flushes, cacheToCache, invalidations, backInvalidations);
+    }
+};
+
+// lru recency stack over local access time - a fenwick tree marks the latest access of every
+// live block, so the reuse distance of a block is the number of marks after its previous access,
+// O(log n). the stamps are renumbered when the tree fills so its size follows the live blocks.
+// lastTime (block -> stamp) is owned by the caller so several stacks can share one map
+class RecencyStack {
+public:
+    typedef std::unordered_map<unsigned long, unsigned> StampMap;
+
+    explicit RecencyStack(unsigned minCap = 64) : now(0), live(0), minCap(minCap) {}
+    // record an access of block (never 0), false on a first touch, else dist = distinct blocks since
+    bool touch(unsigned long block, StampMap& lastTime, unsigned long& dist) {
+        if (now + 1 >= bit.size()) {
+            compact(lastTime);
+        }
+        StampMap::iterator it = lastTime.find(block);
+        bool seen = it != lastTime.end();
+        if (seen) {
+            unsigned last = it->second;
+            dist = bitSum(now) - bitSum(last);
+            bitAdd(last, -1);
+            owner[last] = 0;
+        } else {
+            live++;
+        }
+        now++;
+        bitAdd(now, 1);
+        owner[now] = block;
+        lastTime[block] = now;
+        return seen;
+    }
+
+private:
+    std::vector<unsigned> bit; // fenwick tree over local time
+    std::vector<unsigned long> owner; // block that owns each time stamp (0 = dead)
+    unsigned now; // local time
+    size_t live; // number of distinct blocks
+    unsigned minCap;
+
+    void bitAdd(unsigned pos, int val) {
+        for (; pos < bit.size(); pos += pos & (~pos + 1)) {
+            bit[pos] += val;
+        }
+    }
+    unsigned bitSum(unsigned pos) const {
+        unsigned sum = 0;
+        for (; pos > 0; pos -= pos & (~pos + 1)) {
+            sum += bit[pos];
+        }
+        return sum;
+    }
+    // renumber the live stamps 1..live and grow the tree if needed
+    void compact(StampMap& lastTime) {
+        size_t cap = bit.size() < minCap ? minCap : bit.size();
+        while (2 * (live + 1) > cap) {
+            cap *= 2;
+        }
+        std::vector<unsigned long> renumbered(cap, 0);
+        unsigned t = 0;
+        for (unsigned i = 1; i <= now; i++) {
+            if (owner[i] != 0) {
+                renumbered[++t] = owner[i];
+                lastTime[owner[i]] = t;
+            }
+        }
+        owner.swap(renumbered);
+        bit.assign(cap, 0);
+        for (unsigned i = 1; i <= t; i++) {
+            bitAdd(i, 1);
+        }
+        now = t;
+    }
+};
+
+// one pass lru simulation of every l1 geometry (mattson stack distance)
+// each set count keeps a recency stack per set, the stack distance of an access is its
+// reuse distance within the set
+class StackDistance {
+private:
+    struct Level {
+        unsigned set_size; // set bits
+        std::vector<RecencyStack> sets;
+        RecencyStack::StampMap lastTime; // block -> local time stamp in its set
+        std::vector<double> hist; // hist[d] = accesses with stack distance d
+        double far = 0; // distance beyond max ways or first touch
+    };
+    unsigned offset_size;
+    unsigned max_assoc; // log2 of the largest way count reported
+    std::vector<Level> levels;
+    double accesses;
+
+public:
+    StackDistance(unsigned blockSize, unsigned minSets, unsigned maxSets, unsigned maxAssoc)
+        : offset_size(blockSize), max_assoc(maxAssoc), accesses(0) {
+        for (unsigned s = minSets; s <= maxSets; s++) {
+            Level level;
+            level.set_size = s;
+            level.sets.resize(1 << s);
+            level.hist.assign(1 << maxAssoc, 0);
+            levels.push_back(level);
+        }
+    }
+    // feed one access, every access allocates (write allocate lru)
+    void access(unsigned long address) {
+        accesses++;
+        unsigned long block = (address >> offset_size) + 1; // +1 so 0 marks a dead stamp
+        for (unsigned l = 0; l < levels.size(); l++) {
+            Level& level = levels[l];
+            RecencyStack& set = level.sets[(block - 1) & ((1 << level.set_size) - 1)];
+            unsigned long dist;
+            if (!set.touch(block, level.lastTime, dist)) {
+                level.far++; // compulsory
+            } else if (dist < level.hist.size()) {
+                level.hist[dist]++;
+            } else {
+                level.far++;
+            }
+        }
+    }
+    // print miss rate of every (size, assoc) pair, sizes in log2 like the flags
+    void print_statistics() const {
+        CACHE_PROFILE_SCOPE(PROF_OUTPUT);
+        for (unsigned l = 0; l < levels.size(); l++) {
+            const Level& level = levels[l];
+            double hits = 0;
+            unsigned d = 0;
+            for (unsigned a = 0; a <= max_assoc; a++) {
+                for (; d < (1u << a); d++) {
+                    hits += level.hist[d];
+                }
+                printf("l1-size=%u l1-assoc=%u ", offset_size + level.set_size + a, a);
+                printf("L1miss=%.03f\n", (float)((accesses - hits) / accesses));
+            }
+        }
+    }
+};
+/*-------------------------------------------------------------------------------------------------------*/
+
+
+#endif /* CACHE_SIM_H_ */
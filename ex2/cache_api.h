@@ -0,0 +1,66 @@
+/* 046267 Computer Architecture - HW #2 */
+/* C API for the cache simulator library */
+
+#ifndef CACHE_API_H_
+#define CACHE_API_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_MAX_LEVELS 8
+
+/* Opaque cache hierarchy handle */
+typedef struct cache_sim cache_sim;
+
+/* One memory access of a batch */
+typedef struct {
+	uint64_t address;           // byte address, low 32 bits unless built with ADDR64=1
+	char operation;             // 'r' or 'w'
+} cache_access;
+
+/* Cumulative statistics of a cache hierarchy */
+typedef struct {
+	unsigned levels;                          // number of cache levels
+	double accesses[CACHE_MAX_LEVELS];        // accesses reaching each level
+	double misses[CACHE_MAX_LEVELS];          // misses of each level
+	double writebacks[CACHE_MAX_LEVELS];      // dirty blocks leaving each level
+	double total_time;                        // cycles of all accesses (AMAT = total_time / accesses[0])
+} cache_stats;
+
+/*
+ * cache_sim_create - build a cache hierarchy
+ * param[in] options - the cacheSim command line flags, e.g. "--mem-cyc 100 --bsize 5 --l1-size 10 ..."
+ * return the handle, or NULL when an option is not valid
+ */
+cache_sim *cache_sim_create(const char *options);
+
+/*
+ * cache_sim_destroy - free a hierarchy built by cache_sim_create
+ */
+void cache_sim_destroy(cache_sim *sim);
+
+/*
+ * cache_sim_access - simulate a single access
+ */
+void cache_sim_access(cache_sim *sim, uint64_t address, char operation);
+
+/*
+ * cache_sim_access_batch - simulate count accesses in one call
+ * param[out] stats - the cumulative statistics after the batch (may be NULL)
+ */
+void cache_sim_access_batch(cache_sim *sim, const cache_access *records, size_t count, cache_stats *stats);
+
+/*
+ * cache_sim_get_stats - return the cumulative statistics using a pointer
+ */
+void cache_sim_get_stats(const cache_sim *sim, cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CACHE_API_H_ */
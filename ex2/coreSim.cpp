@@ -0,0 +1,181 @@
+// course - Computer Architecture 046267
+// combined core model - the hw-1 branch predictor and the hw-2 cache hierarchy on one trace
+// usage: coreSim <trace> [cache system flags] [--l1i-size/assoc/cyc n] [--flush-penalty n]
+// trace: first line is the predictor config as in bp_main, then one instruction per line
+//   I 0x<pc>                    - any other instruction
+//   B 0x<pc> T|N 0x<target>     - branch
+//   L 0x<pc> 0x<address>        - load
+//   S 0x<pc> 0x<address>        - store
+// in order single issue core - one cycle per instruction plus the stalls, fetch time beyond
+// the L1I hit and load time beyond the L1 hit stall the core, stores retire through a store
+// buffer and do not stall, a flush costs the flush penalty
+/*------------------------------------------------*/
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "cacheSim.h"
+#include "bp_api.h"
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::stringstream;
+using namespace std;
+
+// predictor config line "<btb> <history> <tag> <fsm> <global_history|local_history>
+// <global_tables|local_tables> <using_share_lsb|using_share_mid|not_using_share>
+// [tournament_pc|tournament_global] [long_history_<bits>]"
+static bool initPredictor(const string& line, int& tournament) {
+	stringstream ss(line);
+	unsigned btbSize = 0, historySize = 0, tagSize = 0, fsmState = 0;
+	string hist, table, share, option;
+	if (!(ss >> btbSize >> historySize >> tagSize >> fsmState >> hist >> table >> share)) {
+		return false;
+	}
+	tournament = BP_TOURNAMENT_OFF;
+	unsigned longHistory = 0;
+	while (ss >> option) {
+		if (option == "tournament_pc") {
+			tournament = BP_TOURNAMENT_PC;
+		} else if (option == "tournament_global") {
+			tournament = BP_TOURNAMENT_GLOBAL;
+		} else if (sscanf(option.c_str(), "long_history_%u", &longHistory) != 1 || longHistory == 0) {
+			return false;
+		}
+	}
+	BP_setTournament(tournament);
+	BP_setLongHistory(longHistory);
+	if ((hist != "global_history" && hist != "local_history") ||
+	    (table != "global_tables" && table != "local_tables")) {
+		return false;
+	}
+	int shared;
+	if (share == "using_share_lsb") {
+		shared = 1;
+	} else if (share == "using_share_mid") {
+		shared = 2;
+	} else if (share == "not_using_share") {
+		shared = 0;
+	} else {
+		return false;
+	}
+	return BP_init(btbSize, historySize, tagSize, fsmState, hist == "global_history", table == "global_tables",
+	               shared) >= 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cerr << "Not enough arguments" << endl;
+		return 0;
+	}
+	ifstream file(argv[1]);
+	if (!file || !file.good()) {
+		cerr << "File not found" << endl;
+		return 0;
+	}
+	SimConfig cfg;
+	cfg.MemCyc = 100;
+	cfg.BSize = 6;
+	cfg.WrAlloc = 1;
+	cfg.levels[0].Size = 15;
+	cfg.levels[0].Assoc = 3;
+	cfg.levels[0].Cyc = 1;
+	cfg.levels[1].Size = 20;
+	cfg.levels[1].Assoc = 4;
+	cfg.levels[1].Cyc = 10;
+	cfg.L1ISize = 15;
+	cfg.L1IAssoc = 2;
+	cfg.L1ICyc = 1;
+	unsigned FlushPenalty = 10;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		string s(argv[i]);
+		if (s == "--flush-penalty") {
+			FlushPenalty = atoi(argv[i + 1]);
+		} else if (!parseSimOption(s, argv[i + 1], cfg)) {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+	}
+	if (cfg.L1ISize == 0 || cfg.levels.size() < 2 || !checkSimConfig(cfg)) {
+		cerr << "Error in arguments" << endl; // the L1I needs a shared level below it
+		return 0;
+	}
+	string line;
+	int tournament;
+	if (!getline(file, line) || !initPredictor(line, tournament)) {
+		cerr << "Error in input file: cannot read config" << endl;
+		return 0;
+	}
+	CacheSystem cacheSystem(cfg);
+	double instructions = 0, loads = 0, stores = 0;
+	double flushCycles = 0, icacheCycles = 0, dcacheCycles = 0;
+	while (getline(file, line)) {
+		if (line.empty()) {
+			continue;
+		}
+		stringstream ss(line);
+		char kind = 0;
+		string pcField;
+		if (!(ss >> kind >> pcField)) {
+			cout << "Command Format error" << endl;
+			return 0;
+		}
+		unsigned long pc = strtoul(pcField.c_str(), NULL, 16);
+		instructions++;
+		icacheCycles += cacheSystem.fetch(pc) - cfg.L1ICyc;
+		if (kind == 'B') {
+			string direction, targetField;
+			if (!(ss >> direction >> targetField) || (direction != "T" && direction != "N")) {
+				cout << "Command Format error" << endl;
+				return 0;
+			}
+			uint32_t target = (uint32_t)strtoul(targetField.c_str(), NULL, 16);
+			bool taken = (direction == "T");
+			uint32_t dst = 0;
+			BP_predict((uint32_t)pc, &dst);
+			unsigned flushes = BP_getFlushes();
+			BP_update((uint32_t)pc, target, taken, dst);
+			flushCycles += (double)(BP_getFlushes() - flushes) * FlushPenalty;
+		} else if (kind == 'L' || kind == 'S') {
+			string addressField;
+			if (!(ss >> addressField)) {
+				cout << "Command Format error" << endl;
+				return 0;
+			}
+			unsigned long address = strtoul(addressField.c_str(), NULL, 16);
+			double before = cacheSystem.getTotalTime();
+			cacheSystem.access(address, kind == 'L' ? 'r' : 'w');
+			if (kind == 'L') {
+				loads++;
+				dcacheCycles += cacheSystem.getTotalTime() - before - cfg.levels[0].Cyc;
+			} else {
+				stores++;
+			}
+		} else if (kind != 'I') {
+			cout << "Command Format error" << endl;
+			return 0;
+		}
+	}
+	CACHE_PROFILE_RECORDS(instructions);
+	SIM_stats stats;
+	BP_GetStats(&stats);
+	double cycles = instructions + flushCycles + icacheCycles + dcacheCycles;
+	double perInstruction = instructions > 0 ? 1.0 / instructions : 0; // empty trace - all ratios 0
+	printf("Instructions=%.0f Cycles=%.0f CPI=%.03f Base=%.03f Flush=%.03f ICache=%.03f DCache=%.03f\n",
+	       instructions, cycles, (float)(cycles * perInstruction), instructions > 0 ? 1.0 : 0.0,
+	       (float)(flushCycles * perInstruction), (float)(icacheCycles * perInstruction),
+	       (float)(dcacheCycles * perInstruction));
+	printf("Branches=%u Flushes=%u Loads=%.0f Stores=%.0f", stats.br_num, stats.flush_num, loads, stores);
+	if (tournament != BP_TOURNAMENT_OFF) {
+		printf(" LocalChosen=%u LocalCorrect=%u GshareChosen=%u GshareCorrect=%u", stats.local_chosen,
+		       stats.local_correct, stats.gshare_chosen, stats.gshare_correct);
+	}
+	printf("\n");
+	if (instructions > 0) { // no accesses - no miss rates
+		cacheSystem.print_statistics();
+	}
+	return 0;
+}
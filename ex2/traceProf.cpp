@@ -0,0 +1,181 @@
+// course - Computer Architecture 046267
+// hw-2 cache simulator - trace profiler, characterises a trace before running cacheSim grids
+// usage: traceProf <trace> [--bsize log2] [--window accesses] [--region log2] [--heatmap-out file]
+// prints the block reuse distance histogram, the fully associative lru miss rate it implies for
+// every power of 2 capacity, and the working set of every window. --heatmap-out writes
+// "window,region,reads,writes" rows. memory grows with the distinct blocks, not the trace length.
+/*------------------------------------------------*/
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include "cacheSim.h"
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using namespace std;
+
+// fully associative reuse distance (distinct blocks between two accesses of a block)
+// one recency stack over the whole trace, memory follows the distinct blocks
+class ReuseProfile {
+private:
+    RecencyStack stack;
+    RecencyStack::StampMap lastTime; // block -> time stamp
+
+public:
+    // hist[0] - distance 0, hist[b] - distance in [2^(b-1), 2^b)
+    std::vector<double> hist;
+    double cold;
+
+    ReuseProfile() : stack(1024), hist(65, 0), cold(0) {}
+    void access(unsigned long block) {
+        unsigned long dist;
+        if (!stack.touch(block + 1, lastTime, dist)) { // 0 marks a dead stamp
+            cold++;
+            return;
+        }
+        unsigned b = 0;
+        while (dist >> b) {
+            b++;
+        }
+        hist[b]++;
+    }
+    // distinct blocks seen so far
+    size_t footprint() const {
+        return lastTime.size();
+    }
+};
+
+// working set and region heatmap of one window of accesses
+class WindowProfile {
+private:
+    unsigned blockBits, regionBits;
+    FILE* heatmap; // NULL - no heatmap
+    unsigned long index;
+    std::unordered_set<unsigned long> blocks; // working set of the current window
+    std::map<unsigned long, std::pair<double, double> > regions; // region -> reads, writes
+public:
+    WindowProfile(unsigned blockBits, unsigned regionBits, FILE* heatmap)
+        : blockBits(blockBits), regionBits(regionBits), heatmap(heatmap), index(0) {}
+    void access(unsigned long address, bool write) {
+        blocks.insert(address >> blockBits);
+        if (heatmap) {
+            std::pair<double, double>& count = regions[address >> regionBits];
+            if (write) {
+                count.second++;
+            } else {
+                count.first++;
+            }
+        }
+    }
+    // print the window and start the next one
+    void close(unsigned long accesses, size_t footprint) {
+        printf("window=%lu accesses=%lu wss=%lu wssBytes=%lu footprint=%lu\n", index, accesses,
+               (unsigned long)blocks.size(), (unsigned long)blocks.size() << blockBits, (unsigned long)footprint);
+        if (heatmap) {
+            for (std::map<unsigned long, std::pair<double, double> >::iterator it = regions.begin();
+                 it != regions.end(); ++it) {
+                fprintf(heatmap, "%lu,0x%lx,%.0f,%.0f\n", index, it->first << regionBits, it->second.first,
+                        it->second.second);
+            }
+            regions.clear();
+        }
+        blocks.clear();
+        index++;
+    }
+};
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		cerr << "Not enough arguments" << endl;
+		return 0;
+	}
+	ifstream file(argv[1]);
+	if (!file || !file.good()) {
+		cerr << "File not found" << endl;
+		return 0;
+	}
+	unsigned BSize = 6;
+	unsigned long Window = 1000000;
+	unsigned Region = 20; // 1MB heatmap regions
+	string HeatmapOut;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		string s(argv[i]);
+		if (s == "--bsize") {
+			BSize = atoi(argv[i + 1]);
+		} else if (s == "--window") {
+			Window = strtoul(argv[i + 1], NULL, 10);
+		} else if (s == "--region") {
+			Region = atoi(argv[i + 1]);
+		} else if (s == "--heatmap-out") {
+			HeatmapOut = argv[i + 1];
+		} else {
+			cerr << "Error in arguments" << endl;
+			return 0;
+		}
+	}
+	if (Window == 0 || Region < BSize) {
+		cerr << "Error in arguments" << endl;
+		return 0;
+	}
+	FILE* heatmap = NULL;
+	if (!HeatmapOut.empty()) {
+		heatmap = fopen(HeatmapOut.c_str(), "w");
+		if (!heatmap) {
+			cerr << "Cannot open " << HeatmapOut << endl;
+			return 0;
+		}
+		fprintf(heatmap, "window,region,reads,writes\n");
+	}
+	ReuseProfile reuse;
+	WindowProfile windows(BSize, Region, heatmap);
+	double accesses = 0;
+	unsigned long inWindow = 0;
+	string line;
+	while (getline(file, line)) {
+		char operation = 0;
+		unsigned long num = 0;
+		if (!parseTraceLine(line, operation, num)) {
+			cout << "Command Format error" << endl;
+			return 0;
+		}
+		accesses++;
+		unsigned long block = num >> BSize;
+		reuse.access(block);
+		windows.access(num, operation == 'w');
+		if (++inWindow == Window) {
+			windows.close(inWindow, reuse.footprint());
+			inWindow = 0;
+		}
+	}
+	if (inWindow) {
+		windows.close(inWindow, reuse.footprint());
+	}
+	if (heatmap) {
+		fclose(heatmap);
+	}
+	if (accesses == 0) {
+		return 0;
+	}
+	printf("accesses=%.0f blocks=%lu footprintBytes=%lu cold=%.0f\n", accesses, (unsigned long)reuse.footprint(),
+	       (unsigned long)reuse.footprint() << BSize, reuse.cold);
+	// reuse histogram, then the lru miss rate of a fully associative cache of 2^b blocks
+	unsigned top = 64;
+	while (top > 0 && reuse.hist[top] == 0) {
+		top--;
+	}
+	for (unsigned b = 0; b <= top; b++) {
+		unsigned long lo = b ? 1UL << (b - 1) : 0, hi = b ? (1UL << b) - 1 : 0;
+		printf("reuse=%lu-%lu count=%.0f fraction=%.03f\n", lo, hi, reuse.hist[b], (float)(reuse.hist[b] / accesses));
+	}
+	double hits = 0;
+	for (unsigned b = 0; b <= top + 1 && b < 64; b++) {
+		hits += reuse.hist[b]; // distance < 2^b hits in 2^b blocks
+		printf("size=%u LRUmiss=%.03f\n", b + BSize, (float)((accesses - hits) / accesses));
+	}
+	return 0;
+}